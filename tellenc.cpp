@@ -37,15 +37,33 @@
  * @author  Wu Yongwei
  */
 
-#include <algorithm>        // sort
+#include <algorithm>        // lower_bound/stable_sort
 #include <map>              // map
-#include <memory>           // pair
+#include <set>              // set
+#include <string>           // string
 #include <vector>           // vector
-#include <ctype.h>          // isprint
 #include <errno.h>          // errno
 #include <stdio.h>          // fopen/fclose/fprintf/printf/puts
-#include <stdlib.h>         // exit
-#include <string.h>         // memcmp/strcmp/strerror
+#include <stdlib.h>         // exit/strtod/strtol/strtoul
+#include <string.h>         // memcmp/memcpy/strcmp/strerror/strlen/...
+#include <sys/types.h>      // stat
+#include <sys/stat.h>       // stat
+#include "tellenc_c.h"
+
+// The index is mapped into memory where the system can do it
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <io.h>             // _get_osfhandle
+#include <windows.h>        // CreateFileMapping/MapViewOfFile
+#define HAS_MMAP 1
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>       // mmap/munmap
+#include <unistd.h>         // fstat
+#define HAS_MMAP 1
+#else
+#define HAS_MMAP 0
+#endif
 
 #ifndef _WIN32
 #define __cdecl
@@ -57,536 +75,947 @@
 
 using namespace std;
 
-typedef unsigned short uint16_t;
-typedef unsigned int   uint32_t;
-typedef pair<uint16_t, uint32_t>  char_count_t;
-typedef map<uint16_t, uint32_t>   char_count_map_t;
-typedef vector<char_count_t>      char_count_vec_t;
-
-struct freq_analysis_data_t {
-    uint16_t    dbyte;
-    const char* enc;
-};
+// 32-bit word; not uint32_t, which system headers may define
+typedef unsigned int              word32_t;
+
+// Sizes and times of files, which may need more than 32 bits
+#if __cplusplus >= 201103L || defined(_MSC_VER)
+typedef unsigned long long        count64_t;
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wlong-long"
+typedef unsigned long long        count64_t;
+#pragma GCC diagnostic pop
+#else
+typedef unsigned long             count64_t;
+#endif
 
-struct greater_char_count {
-    bool operator()(const char_count_t& lhs, const char_count_t& rhs)
-    {
-        if (lhs.second > rhs.second) {
-            return true;
-        } else {
-            return false;
-        }
-    }
-};
+// Windows has 64-bit file sizes only in struct _stat64
+#ifdef _WIN32
+typedef struct _stat64            stat_t;
+#define stat_path                 _stat64
+#else
+typedef struct stat               stat_t;
+#define stat_path                 stat
+#endif
+typedef vector<string>            string_vec_t;
+typedef set<string>               string_set_t;
+typedef vector<word32_t>          posting_list_t;
 
-enum UTF8_State {
-    UTF8_INVALID,
-    UTF8_1,
-    UTF8_2,
-    UTF8_3,
-    UTF8_4,
-    UTF8_TAIL
+struct shard_t {
+    unsigned long index;
+    unsigned long count;
 };
 
-static const size_t MAX_CHAR = 256;
-static const unsigned char NON_TEXT_CHARS[] = { 0, 26, 127, 255 };
-static const char NUL = '\0';
-static const char DOS_EOF = '\x1A';
-static const int EVEN = 0;
-static const int ODD  = 1;
-
-static UTF8_State utf8_char_table[MAX_CHAR];
-
-static freq_analysis_data_t freq_analysis_data[] = {
-    { 0x9a74, "windows-1250" },         // "št" (Czech)
-    { 0xe865, "windows-1250" },         // "če" (Czech)
-    { 0xf865, "windows-1250" },         // "ře" (Czech)
-    { 0xe167, "windows-1250" },         // "ág" (Hungarian)
-    { 0xe96c, "windows-1250" },         // "él" (Hungarian)
-    { 0xb36f, "windows-1250" },         // "ło" (Polish)
-    { 0xea7a, "windows-1250" },         // "ęz" (Polish)
-    { 0xf377, "windows-1250" },         // "ów" (Polish)
-    { 0x9d20, "windows-1250" },         // "ť " (Slovak)
-    { 0xfa9d, "windows-1250" },         // "úť" (Slovak)
-    { 0x9e69, "windows-1250" },         // "ži" (Slovenian)
-    { 0xe869, "windows-1250" },         // "či" (Slovenian)
-    { 0xe020, "windows-1252" },         // "à " (French)
-    { 0xe920, "windows-1252" },         // "é " (French)
-    { 0xe963, "windows-1252" },         // "éc" (French)
-    { 0xe965, "windows-1252" },         // "ée" (French)
-    { 0xe972, "windows-1252" },         // "ér" (French)
-    { 0xe4e4, "windows-1252" },         // "ää" (Finnish)
-    { 0xe474, "windows-1252" },         // "ät" (German)
-    { 0xfc72, "windows-1252" },         // "ür" (German)
-    { 0xed6e, "windows-1252" },         // "ín" (Spanish)
-    { 0xf36e, "windows-1252" },         // "ón" (Spanish)
-    { 0x8220, "cp437" },                // "é " (French)
-    { 0x8263, "cp437" },                // "éc" (French)
-    { 0x8265, "cp437" },                // "ée" (French)
-    { 0x8272, "cp437" },                // "ér" (French)
-    { 0x8520, "cp437" },                // "à " (French)
-    { 0x8172, "cp437" },                // "ür" (German)
-    { 0x8474, "cp437" },                // "ät" (German)
-    { 0xc4c4, "cp437" },                // "──"
-    { 0xcdcd, "cp437" },                // "══"
-    { 0xdbdb, "cp437" },                // "██"
-    { 0xa1a1, "gbk" },                  // "　"
-    { 0xa1a2, "gbk" },                  // "、"
-    { 0xa1a3, "gbk" },                  // "。"
-    { 0xa1a4, "gbk" },                  // "·"
-    { 0xa1b6, "gbk" },                  // "《"
-    { 0xa1b7, "gbk" },                  // "》"
-    { 0xa3ac, "gbk" },                  // "，"
-    { 0xa3ba, "gbk" },                  // "："
-    { 0xb5c4, "gbk" },                  // "的"
-    { 0xc1cb, "gbk" },                  // "了"
-    { 0xd2bb, "gbk" },                  // "一"
-    { 0xcac7, "gbk" },                  // "是"
-    { 0xb2bb, "gbk" },                  // "不"
-    { 0xb8f6, "gbk" },                  // "个"
-    { 0xc8cb, "gbk" },                  // "人"
-    { 0xd5e2, "gbk" },                  // "这"
-    { 0xd3d0, "gbk" },                  // "有"
-    { 0xced2, "gbk" },                  // "我"
-    { 0xc4e3, "gbk" },                  // "你"
-    { 0xcbfb, "gbk" },                  // "他"
-    { 0xcbfd, "gbk" },                  // "她"
-    { 0xc9cf, "gbk" },                  // "上"
-    { 0xbfb4, "gbk" },                  // "看"
-    { 0xd6ae, "gbk" },                  // "之"
-    { 0xbbb9, "gbk" },                  // "还"
-    { 0xbfc9, "gbk" },                  // "可"
-    { 0xbaf3, "gbk" },                  // "后"
-    { 0xd6d0, "gbk" },                  // "中"
-    { 0xd0d0, "gbk" },                  // "行"
-    { 0xb1d2, "gbk" },                  // "币"
-    { 0xb3f6, "gbk" },                  // "出"
-    { 0xb7d1, "gbk" },                  // "费"
-    { 0xb8d0, "gbk" },                  // "感"
-    { 0xbef5, "gbk" },                  // "觉"
-    { 0xc4ea, "gbk" },                  // "年"
-    { 0xd4c2, "gbk" },                  // "月"
-    { 0xc8d5, "gbk" },                  // "日"
-    { 0xa140, "big5" },                 // "　"
-    { 0xa141, "big5" },                 // "，"
-    { 0xa143, "big5" },                 // "。"
-    { 0xa147, "big5" },                 // "："
-    { 0xaaba, "big5" },                 // "的"
-    { 0xa446, "big5" },                 // "了"
-    { 0xa440, "big5" },                 // "一"
-    { 0xac4f, "big5" },                 // "是"
-    { 0xa4a3, "big5" },                 // "不"
-    { 0xa448, "big5" },                 // "人"
-    { 0xa7da, "big5" },                 // "我"
-    { 0xa741, "big5" },                 // "你"
-    { 0xa54c, "big5" },                 // "他"
-    { 0xa66f, "big5" },                 // "她"
-    { 0xadd3, "big5" },                 // "個"
-    { 0xa457, "big5" },                 // "上"
-    { 0xa662, "big5" },                 // "在"
-    { 0xbba1, "big5" },                 // "說"
-    { 0xa65e, "big5" },                 // "回"
-    { 0x8140, "sjis" },                 // "　"
-    { 0x8141, "sjis" },                 // "、"
-    { 0x8142, "sjis" },                 // "。"
-    { 0x8145, "sjis" },                 // "・"
-    { 0x8146, "sjis" },                 // "："
-    { 0x815b, "sjis" },                 // "ー"
-    { 0x82b5, "sjis" },                 // "し"
-    { 0x82bd, "sjis" },                 // "た"
-    { 0x82c8, "sjis" },                 // "な"
-    { 0x82c9, "sjis" },                 // "に"
-    { 0x82cc, "sjis" },                 // "の"
-    { 0x82dc, "sjis" },                 // "ま"
-    { 0x82f0, "sjis" },                 // "を"
-    { 0x8367, "sjis" },                 // "ト"
-    { 0x8393, "sjis" },                 // "ン"
-    { 0x89ef, "sjis" },                 // "会"
-    { 0x906c, "sjis" },                 // "人"
-    { 0x9094, "sjis" },                 // "数"
-    { 0x93fa, "sjis" },                 // "日"
-    { 0x95f1, "sjis" },                 // "報"
-    { 0xa1bc, "euc-jp" },               // "ー"
-    { 0xa4bf, "euc-jp" },               // "た"
-    { 0xa4ca, "euc-jp" },               // "な"
-    { 0xa4cb, "euc-jp" },               // "に"
-    { 0xa4ce, "euc-jp" },               // "の"
-    { 0xa4de, "euc-jp" },               // "ま"
-    { 0xa4f2, "euc-jp" },               // "を"
-    { 0xa5c8, "euc-jp" },               // "ト"
-    { 0xa5f3, "euc-jp" },               // "ン"
-    { 0xb2f1, "euc-jp" },               // "会"
-    { 0xbfcd, "euc-jp" },               // "人"
-    { 0xbff4, "euc-jp" },               // "数"
-    { 0xc6fc, "euc-jp" },               // "日"
-    { 0xcaf3, "euc-jp" },               // "報"
-    { 0xc0cc, "euc-kr" },               // "이"
-    { 0xb0fa, "euc-kr" },               // "과"
-    { 0xb1e2, "euc-kr" },               // "기"
-    { 0xb4c2, "euc-kr" },               // "는"
-    { 0xb7ce, "euc-kr" },               // "로"
-    { 0xb1db, "euc-kr" },               // "글"
-    { 0xc5e4, "euc-kr" },               // "토"
-    { 0xc1a4, "euc-kr" },               // "정"
-    { 0xc920, "koi8-r" },               // "и "
-    { 0xc7cf, "koi8-r" },               // "го"
-    { 0xcbcf, "koi8-r" },               // "ко"
-    { 0xd3cb, "koi8-r" },               // "ск"
-    { 0xd3d4, "koi8-r" },               // "ст"
-    { 0xa6a7, "koi8-u" },               // "ії"
-    { 0xa6ce, "koi8-u" },               // "ін"
-    { 0xa6d7, "koi8-u" },               // "ів"
-    { 0xa7ce, "koi8-u" },               // "їн"
-    { 0xd0cf, "koi8-u" },               // "по"
-    { 0xd4c9, "koi8-u" },               // "ти"
+struct index_entry_t {
+    string          path;
+    count64_t       size;
+    count64_t       mtime;          ///< As stored, in two's complement
+    string          enc;
+    unsigned        confidence;     ///< In percent
 };
 
-static size_t nul_count_byte[2];
-static size_t nul_count_word[2];
+typedef map<string, index_entry_t>    index_map_t;
+typedef map<string, posting_list_t>   posting_map_t;
+
+static const char INDEX_MAGIC[] = "tellenc index 2\n";   // 16 bytes
+
+static const char* checkpoint_file = NULL;
+static const char* index_file = NULL;
+static const char* query_prefix = "";
+static const char* query_enc = NULL;
+static bool query_summary = false;
+static shard_t shard = { 0, 1 };
+static bool verbose = false;
+static bool sniff_declared = false;
+static bool stop_early = false;
+static long max_utf8_errors = -1;   // ppm; -1 for the default
+static vector<int> candidates;
+static vector<double> candidate_priors;
+static tellenc_ctx* ctx = NULL;
 
-static bool is_binary = false;
-static bool is_valid_utf8 = true;
-static bool is_valid_latin1 = true;
-static uint32_t dbyte_cnt = 0;
-static uint32_t dbyte_hihi_cnt = 0;
+static void usage()
+{
+    fprintf(stderr,
+            "Usage: tellenc [-v] [--sniff-declared] [--max-utf8-errors=RATE]"
+            " [--candidates=ENC[:WEIGHT],...] [--stop-early] <filename> \n"
+            "       tellenc [-v] [--sniff-declared] [--max-utf8-errors=RATE]"
+            " [--candidates=ENC[:WEIGHT],...] [--stop-early]"
+            " [--shard=I/N] [--checkpoint=FILE] [--files-from=FILE]"
+            " <filename>... \n"
+            "       tellenc --merge <result_file>... \n"
+            "       tellenc --index=FILE [--files-from=FILE]"
+            " [<filename>...] \n"
+            "       tellenc --query=FILE [--prefix=PATH] [--encoding=ENC]"
+            " [--summary] \n");
+}
 
-bool verbose = false;
+static bool parse_shard(const char* arg, shard_t& result)
+{
+    char* end;
+    result.index = strtoul(arg, &end, 10);
+    if (end == arg || *end != '/') {
+        return false;
+    }
+    arg = end + 1;
+    result.count = strtoul(arg, &end, 10);
+    if (end == arg || *end != '\0') {
+        return false;
+    }
+    return result.count != 0 && result.index < result.count;
+}
 
-static inline bool is_non_text(char ch)
+static bool parse_candidates(const char* arg)
 {
-    for (size_t i = 0; i < sizeof(NON_TEXT_CHARS); ++i) {
-        if (ch == NON_TEXT_CHARS[i]) {
+    for (;;) {
+        size_t len = strcspn(arg, ",:");
+        string name(arg, len);
+        int enc = tellenc_encoding_id_of(name.c_str());
+        if (enc == 0) {
+            fprintf(stderr, "Unknown encoding `%s' \n", name.c_str());
+            return false;
+        }
+        double prior = 1;
+        arg += len;
+        if (*arg == ':') {
+            char* end;
+            prior = strtod(arg + 1, &end);
+            if (end == arg + 1 || (*end != ',' && *end != '\0') ||
+                    !(prior > 0)) {
+                fprintf(stderr, "Invalid weight for `%s' \n", name.c_str());
+                return false;
+            }
+            arg = end;
+        }
+        candidates.push_back(enc);
+        candidate_priors.push_back(prior);
+        if (*arg == '\0') {
             return true;
         }
+        ++arg;
     }
-    return false;
 }
 
-void init_utf8_char_table()
+static word32_t hash_path(const char* path)
 {
-    int ch = 0;
-    utf8_char_table[ch] = UTF8_INVALID;
-    ++ch;
-    for (; ch <= 0x7f; ++ch) {
-        utf8_char_table[ch] = UTF8_1;
-    }
-    for (; ch <= 0xbf; ++ch) {
-        utf8_char_table[ch] = UTF8_TAIL;
+    // 32-bit FNV-1a: stable across runs and hosts
+    word32_t hash = 2166136261U;
+    for (; *path; ++path) {
+        hash ^= (unsigned char)*path;
+        hash *= 16777619U;
     }
-    for (; ch <= 0xc1; ++ch) {
-        utf8_char_table[ch] = UTF8_INVALID;
+    return hash;
+}
+
+static bool is_in_shard(const char* path)
+{
+    return hash_path(path) % shard.count == shard.index;
+}
+
+static bool read_line(FILE* fp, string& line, bool& complete)
+{
+    int ch;
+    line.clear();
+    complete = false;
+    while ((ch = getc(fp)) != EOF) {
+        if (ch == '\n') {
+            complete = true;
+            return true;
+        }
+        line += (char)ch;
     }
-    for (; ch <= 0xdf; ++ch) {
-        utf8_char_table[ch] = UTF8_2;
+    return !line.empty();
+}
+
+static bool read_file_list(const char* list_file, string_vec_t& paths)
+{
+    FILE* fp = strcmp(list_file, "-") == 0 ? stdin : fopen(list_file, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open file `%s': %s \n",
+                        list_file, strerror(errno));
+        return false;
     }
-    for (; ch <= 0xef; ++ch) {
-        utf8_char_table[ch] = UTF8_3;
+    string line;
+    bool complete;
+    while (read_line(fp, line, complete)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        if (!line.empty()) {
+            paths.push_back(line);
+        }
     }
-    for (; ch <= 0xf4; ++ch) {
-        utf8_char_table[ch] = UTF8_4;
+    if (fp != stdin) {
+        fclose(fp);
     }
-    for (; ch <= 0xff; ++ch) {
-        utf8_char_table[ch] = UTF8_INVALID;
+    return true;
+}
+
+// A result record is "<path>\t<encoding>".  Lines without a tab cannot
+// have been written completely and are ignored.
+static bool split_record(const string& line, string& path)
+{
+    string::size_type pos = line.rfind('\t');
+    if (pos == string::npos || pos == 0 || pos == line.size() - 1) {
+        return false;
     }
+    path = line.substr(0, pos);
+    return true;
 }
 
-static void init_sbyte_char_count(char_count_t sbyte_char_cnt[])
+// Closes the temporary file and moves it over the destination, so that
+// readers never see a half-written file.
+static bool commit_file(FILE* fp, const string& tmp_filename,
+                        const char* filename)
 {
-    for (size_t i = 0; i < MAX_CHAR; ++i) {
-        sbyte_char_cnt[i].first = i;
-        sbyte_char_cnt[i].second = 0;
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Cannot write file `%s': %s \n",
+                        tmp_filename.c_str(), strerror(errno));
+        return false;
+    }
+    remove(filename);
+    if (rename(tmp_filename.c_str(), filename) != 0) {
+        fprintf(stderr, "Cannot rename `%s' to `%s': %s \n",
+                        tmp_filename.c_str(), filename, strerror(errno));
+        return false;
     }
+    return true;
 }
 
-static void print_sbyte_char_cnt(const char_count_t sbyte_char_cnt[])
+static bool load_checkpoint(const char* filename, string_set_t& done)
 {
-    for (size_t i = 0; i < MAX_CHAR; ++i) {
-        unsigned char ch = (unsigned char)sbyte_char_cnt[i].first;
-        if (sbyte_char_cnt[i].second == 0)
-            break;
-        printf("%.2x ('%c'): %-6u    ", ch,
-               isprint(ch) ? ch : '?', sbyte_char_cnt[i].second);
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        // No checkpoint yet: nothing is done
+        return true;
+    }
+    string_vec_t records;
+    string line;
+    string path;
+    bool complete = true;
+    bool truncated = false;
+    while (read_line(fp, line, complete)) {
+        if (complete && split_record(line, path)) {
+            done.insert(path);
+            records.push_back(line);
+        } else {
+            truncated = true;
+        }
+    }
+    fclose(fp);
+    if (!truncated) {
+        return true;
+    }
+
+    // A previous run was interrupted in the middle of a record: rewrite
+    // the checkpoint with complete records only, so that the file stays
+    // mergeable and the interrupted file is processed again.
+    string tmp_filename = string(filename) + ".tmp";
+    fp = fopen(tmp_filename.c_str(), "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open file `%s': %s \n",
+                        tmp_filename.c_str(), strerror(errno));
+        return false;
+    }
+    for (string_vec_t::const_iterator it = records.begin();
+            it != records.end(); ++it) {
+        fprintf(fp, "%s\n", it->c_str());
     }
-    printf("\n");
+    return commit_file(fp, tmp_filename, filename);
 }
 
-static void print_dbyte_char_cnt(const char_count_vec_t& dbyte_char_cnt)
+static const char* detect_file(const char* filename)
 {
-    for (char_count_vec_t::const_iterator it = dbyte_char_cnt.begin();
-            it != dbyte_char_cnt.end(); ++it) {
-        printf("%.4x: %-6u        ", it->first, it->second);
+    static char buffer[TELLENC_BUFFER_SIZE];
+
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open file `%s': %s \n",
+                        filename, strerror(errno));
+        return NULL;
     }
-    printf("\n");
+
+    size_t len;
+    len = fread(buffer, 1, sizeof buffer, fp);
+    fclose(fp);
+
+    int enc = tellenc_ctx_detect(ctx, buffer, len);
+    if (tellenc_ctx_stat(ctx, TELLENC_STAT_IS_DOUBLE_ENCODED)) {
+        return "utf-8 (double-encoded)";
+    }
+    return tellenc_encoding_name_of(enc);
 }
 
-static const char* check_ucs_bom(const unsigned char* const buffer,
-                                 const size_t len)
+static int scan_files(const string_vec_t& paths)
 {
-    const struct pattern_t {
-        const char* name;
-        const char* pattern;
-        size_t pattern_len;
-    } patterns[] = {
-        { "ucs-4",     "\x00\x00\xFE\xFF",  4 },
-        { "ucs-4le",   "\xFF\xFE\x00\x00",  4 },
-        { "utf-8",     "\xEF\xBB\xBF",      3 },
-        { "utf-16",    "\xFE\xFF",          2 },
-        { "utf-16le",  "\xFF\xFE",          2 },
-        { NULL,        NULL,                0 }
-    };
-    for (size_t i = 0; patterns[i].name; ++i) {
-        const pattern_t& item = patterns[i];
-        if (len >= item.pattern_len &&
-            memcmp(buffer, item.pattern, item.pattern_len) == 0) {
-            return item.name;
+    string_set_t done;
+    FILE* output = stdout;
+    if (checkpoint_file) {
+        if (!load_checkpoint(checkpoint_file, done)) {
+            return EXIT_FAILURE;
+        }
+        output = fopen(checkpoint_file, "ab");
+        if (output == NULL) {
+            fprintf(stderr, "Cannot open file `%s': %s \n",
+                            checkpoint_file, strerror(errno));
+            return EXIT_FAILURE;
         }
     }
-    return NULL;
+
+    int status = EXIT_SUCCESS;
+    for (string_vec_t::const_iterator it = paths.begin();
+            it != paths.end(); ++it) {
+        const char* path = it->c_str();
+        if (!is_in_shard(path) || done.count(*it)) {
+            continue;
+        }
+        const char* enc = detect_file(path);
+        if (enc == NULL) {
+            status = EXIT_FAILURE;
+            continue;
+        }
+        // Flush per record, so that a crash loses at most the file
+        // being processed
+        fprintf(output, "%s\t%s\n", path, enc);
+        fflush(output);
+        done.insert(*it);
+    }
+
+    if (output != stdout && fclose(output) != 0) {
+        status = EXIT_FAILURE;
+    }
+    return status;
 }
 
-static const char* check_freq_dbyte(uint16_t dbyte)
+// A record to merge, with the length of its path found once, so that
+// sorting does not split or copy the records
+struct record_key_t {
+    size_t          line_no;
+    size_t          path_len;
+};
+
+struct less_record_path {
+    explicit less_record_path(const string_vec_t& records)
+        : records_(records)
+    {
+    }
+    bool operator()(const record_key_t& lhs, const record_key_t& rhs) const
+    {
+        return compare(lhs, rhs) < 0;
+    }
+    int compare(const record_key_t& lhs, const record_key_t& rhs) const
+    {
+        return records_[lhs.line_no].compare(0, lhs.path_len,
+                                             records_[rhs.line_no], 0,
+                                             rhs.path_len);
+    }
+
+private:
+    const string_vec_t& records_;
+};
+
+static int merge_results(int count, char* filenames[])
 {
-    for (size_t i = 0;
-            i < sizeof freq_analysis_data / sizeof(freq_analysis_data_t);
-            ++i) {
-        if (dbyte == freq_analysis_data[i].dbyte) {
-            if (verbose) {
-                printf("Found frequent double-byte %.4x\n", dbyte);
+    string_vec_t records;
+    vector<record_key_t> keys;
+    string line;
+    string path;
+    bool complete;
+    for (int i = 0; i < count; ++i) {
+        FILE* fp = fopen(filenames[i], "rb");
+        if (fp == NULL) {
+            fprintf(stderr, "Cannot open file `%s': %s \n",
+                            filenames[i], strerror(errno));
+            return EXIT_FAILURE;
+        }
+        while (read_line(fp, line, complete)) {
+            if (complete && split_record(line, path)) {
+                record_key_t key = { records.size(), path.size() };
+                keys.push_back(key);
+                records.push_back(line);
             }
-            return freq_analysis_data[i].enc;
         }
+        fclose(fp);
+    }
+
+    // Stable, so that the last record wins among duplicates from
+    // re-runs over the same path
+    less_record_path less(records);
+    stable_sort(keys.begin(), keys.end(), less);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i + 1 < keys.size() && less.compare(keys[i], keys[i + 1]) == 0) {
+            continue;
+        }
+        printf("%s\n", records[keys[i].line_no].c_str());
+    }
+    return EXIT_SUCCESS;
+}
+
+// The index is binary, in the byte order of the machine that wrote it,
+// so that a query maps it into memory and uses it as it is.  After the
+// magic come the counts of entries, encodings and string bytes, and then,
+// all in 32-bit words:
+//   - the entries, sorted by path: offset of the path in the strings,
+//     number of the encoding, confidence in percent, and size and mtime
+//     (two words each, low first);
+//   - the encodings, sorted by name: offset of the name, and the first
+//     posting and the count of postings;
+//   - the postings: for each encoding in turn, the numbers of its
+//     entries, ascending;
+// and last the NUL-terminated strings.
+static const size_t INDEX_MAGIC_WORDS = (sizeof INDEX_MAGIC - 1) / 4;
+static const size_t INDEX_HEADER_WORDS = INDEX_MAGIC_WORDS + 3;
+static const size_t INDEX_ENTRY_WORDS = 7;
+static const size_t INDEX_ENC_WORDS = 3;
+
+enum Index_Entry_Word {
+    IE_PATH,
+    IE_ENC,
+    IE_CONFIDENCE,
+    IE_SIZE,
+    IE_MTIME = IE_SIZE + 2
+};
+
+enum Index_Enc_Word {
+    IX_NAME,
+    IX_FIRST,
+    IX_COUNT
+};
+
+struct index_t {
+    const word32_t* words;          ///< The whole file
+    size_t          file_size;
+    const void*     view;           ///< Mapped file, or NULL
+    vector<word32_t> buffer;        ///< File read if it cannot be mapped
+    word32_t        entry_count;
+    word32_t        enc_count;
+    word32_t        string_size;
+    const word32_t* entries;
+    const word32_t* encs;
+    const word32_t* postings;
+    const char*     strings;
+
+    index_t()
+        : words(NULL), file_size(0), view(NULL),
+          entry_count(0), enc_count(0), string_size(0)
+    {
+    }
+    ~index_t() { close(); }
+
+    void close()
+    {
+#if defined(_WIN32)
+        if (view) {
+            UnmapViewOfFile(view);
+        }
+#elif HAS_MMAP
+        if (view) {
+            munmap(const_cast<void*>(view), file_size);
+        }
+#endif
+        view = NULL;
+        vector<word32_t>().swap(buffer);
+        words = NULL;
+        file_size = 0;
+        entry_count = enc_count = string_size = 0;
+    }
+
+    const char* string_at(word32_t offset) const
+    {
+        return offset < string_size ? strings + offset : "";
+    }
+    const char* path(word32_t entry) const
+    {
+        return string_at(entries[entry * INDEX_ENTRY_WORDS + IE_PATH]);
+    }
+    word32_t enc(word32_t entry) const
+    {
+        return entries[entry * INDEX_ENTRY_WORDS + IE_ENC];
     }
-    return NULL;
+    const char* enc_name(word32_t enc) const
+    {
+        return enc < enc_count
+             ? string_at(encs[enc * INDEX_ENC_WORDS + IX_NAME]) : "";
+    }
+
+private:
+    index_t(const index_t&);
+    index_t& operator=(const index_t&);
+};
+
+static void put_words(count64_t value, word32_t* words)
+{
+    words[0] = word32_t(value);
+    words[1] = word32_t(value >> 16 >> 16);
 }
 
-static const char* search_freq_dbytes(const char_count_vec_t& dbyte_char_cnt)
+static count64_t get_words(const word32_t* words)
 {
-    size_t max_comp_idx = 10;
-    if (max_comp_idx > dbyte_char_cnt.size()) {
-        max_comp_idx = dbyte_char_cnt.size();
+    return words[0] | (count64_t)words[1] << 16 << 16;
+}
+
+// Gets the whole index file into memory.  It is mapped where the system
+// can do it, which is safe as an index is only replaced by renaming, and
+// only the pages used by a query are then read; it is read otherwise.
+static bool load_index_file(FILE* fp, index_t& index)
+{
+    count64_t file_size;
+#if defined(_WIN32)
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(fp));
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        return false;
+    }
+    file_size = (count64_t)size.QuadPart;
+#elif HAS_MMAP
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0) {
+        return false;
+    }
+    file_size = (count64_t)st.st_size;
+#else
+    if (fseek(fp, 0, SEEK_END) != 0) {
+        return false;
+    }
+    file_size = (count64_t)ftell(fp);
+    rewind(fp);
+#endif
+    if (file_size < INDEX_HEADER_WORDS * 4 ||
+            (size_t)file_size != file_size) {
+        return false;
+    }
+    index.file_size = (size_t)file_size;
+#if defined(_WIN32)
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0,
+                                        NULL);
+    if (mapping != NULL) {
+        index.view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+#elif HAS_MMAP
+    void* view = mmap(NULL, index.file_size, PROT_READ, MAP_SHARED,
+                      fileno(fp), 0);
+    if (view != MAP_FAILED) {
+        index.view = view;
+    }
+#endif
+    if (index.view) {
+        index.words = (const word32_t*)index.view;
+        return true;
+    }
+    index.buffer.resize((index.file_size + 3) / 4);
+    index.words = &index.buffer[0];
+    return fread(&index.buffer[0], 1, index.file_size, fp) ==
+           index.file_size;
+}
+
+// Gets the index into memory as it is; only the sizes of the sections
+// and the encodings are checked, so that a query does not touch all the
+// file.  Offsets into the strings, and the postings, are checked when
+// used.
+static bool read_index(const char* filename, index_t& index,
+                       bool must_exist)
+{
+    index.close();
+    FILE* fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        if (must_exist || errno != ENOENT) {
+            fprintf(stderr, "Cannot open file `%s': %s \n",
+                            filename, strerror(errno));
+            return false;
+        }
+        return true;
     }
-    for (size_t i = 0; i < max_comp_idx; ++i) {
-        if (const char* enc = check_freq_dbyte(dbyte_char_cnt[i].first)) {
-            return enc;
+    bool is_index = load_index_file(fp, index) &&
+                    memcmp(index.words, INDEX_MAGIC,
+                           INDEX_MAGIC_WORDS * 4) == 0;
+    fclose(fp);
+    if (is_index) {
+        const word32_t* header = index.words + INDEX_MAGIC_WORDS;
+        word32_t entry_count = header[0];
+        word32_t enc_count = header[1];
+        word32_t string_size = header[2];
+        double words = INDEX_HEADER_WORDS +
+                       double(entry_count) * (INDEX_ENTRY_WORDS + 1) +
+                       double(enc_count) * INDEX_ENC_WORDS;
+        is_index = words * 4 + string_size == index.file_size &&
+                   (string_size == 0 ||
+                    ((const char*)index.words)[index.file_size - 1] == 0);
+        if (is_index) {
+            index.entry_count = entry_count;
+            index.enc_count = enc_count;
+            index.string_size = string_size;
+            index.entries = index.words + INDEX_HEADER_WORDS;
+            index.encs = index.entries + entry_count * INDEX_ENTRY_WORDS;
+            index.postings = index.encs + enc_count * INDEX_ENC_WORDS;
+            index.strings = (const char*)(index.postings + entry_count);
         }
     }
-    return NULL;
+    for (word32_t i = 0; is_index && i < index.enc_count; ++i) {
+        const word32_t* enc = index.encs + i * INDEX_ENC_WORDS;
+        is_index = enc[IX_FIRST] <= index.entry_count &&
+                   enc[IX_COUNT] <= index.entry_count - enc[IX_FIRST];
+    }
+    if (!is_index) {
+        fprintf(stderr, "`%s' is not a tellenc index \n", filename);
+        index.close();
+        return false;
+    }
+    return true;
 }
 
-const char* tellenc(const unsigned char* const buffer, const size_t len)
+static bool stat_file(const char* path, count64_t& size, count64_t& mtime)
 {
-    if (len == 0) {
-        return "unknown";
+    stat_t st;
+    if (stat_path(path, &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG) {
+        return false;
     }
+    size = (count64_t)st.st_size;
+    mtime = (count64_t)st.st_mtime;
+    return true;
+}
+
+static void append_string(string& strings, const string& str,
+                          word32_t& offset)
+{
+    offset = (word32_t)strings.size();
+    strings.append(str.c_str(), str.size() + 1);
+}
 
-    if (const char* result = check_ucs_bom(buffer, len)) {
-        return result;
+static bool write_index(const index_map_t& entries)
+{
+    // Entry numbers follow the order of the paths in the map
+    posting_map_t postings;
+    word32_t entry_no = 0;
+    for (index_map_t::const_iterator it = entries.begin();
+            it != entries.end(); ++it) {
+        postings[it->second.enc].push_back(entry_no++);
     }
 
-    char_count_t sbyte_char_cnt[MAX_CHAR];
-    char_count_map_t dbyte_char_cnt_map;
-    init_sbyte_char_count(sbyte_char_cnt);
+    string strings;
+    vector<word32_t> words(INDEX_MAGIC_WORDS);
+    memcpy(&words[0], INDEX_MAGIC, INDEX_MAGIC_WORDS * 4);
+    words.push_back((word32_t)entries.size());
+    words.push_back((word32_t)postings.size());
+    words.push_back(0);             // string size, filled in below
+    map<string, word32_t> enc_nos;
+    for (posting_map_t::const_iterator it = postings.begin();
+            it != postings.end(); ++it) {
+        word32_t enc_no = (word32_t)enc_nos.size();
+        enc_nos[it->first] = enc_no;
+    }
+    for (index_map_t::const_iterator it = entries.begin();
+            it != entries.end(); ++it) {
+        const index_entry_t& entry = it->second;
+        word32_t record[INDEX_ENTRY_WORDS];
+        append_string(strings, entry.path, record[IE_PATH]);
+        record[IE_ENC] = enc_nos[entry.enc];
+        record[IE_CONFIDENCE] = entry.confidence;
+        put_words(entry.size, record + IE_SIZE);
+        put_words(entry.mtime, record + IE_MTIME);
+        words.insert(words.end(), record, record + INDEX_ENTRY_WORDS);
+    }
+    word32_t first = 0;
+    for (posting_map_t::const_iterator it = postings.begin();
+            it != postings.end(); ++it) {
+        word32_t record[INDEX_ENC_WORDS];
+        append_string(strings, it->first, record[IX_NAME]);
+        record[IX_FIRST] = first;
+        record[IX_COUNT] = (word32_t)it->second.size();
+        words.insert(words.end(), record, record + INDEX_ENC_WORDS);
+        first += record[IX_COUNT];
+    }
+    for (posting_map_t::const_iterator it = postings.begin();
+            it != postings.end(); ++it) {
+        words.insert(words.end(), it->second.begin(), it->second.end());
+    }
+    words[INDEX_MAGIC_WORDS + 2] = (word32_t)strings.size();
 
-    unsigned char ch;
-    int last_ch = EOF;
-    int utf8_state = UTF8_1;
-    for (size_t i = 0; i < len; ++i) {
-        ch = buffer[i];
-        sbyte_char_cnt[ch].second++;
+    string tmp_filename = string(index_file) + ".tmp";
+    FILE* fp = fopen(tmp_filename.c_str(), "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open file `%s': %s \n",
+                        tmp_filename.c_str(), strerror(errno));
+        return false;
+    }
+    fwrite(&words[0], 4, words.size(), fp);
+    fwrite(strings.data(), 1, strings.size(), fp);
+    return commit_file(fp, tmp_filename, index_file);
+}
 
-        // Check for binary data (including UTF-16/32)
-        if (is_non_text(ch)) {
-            if (!is_binary && !(ch == DOS_EOF && i == len - 1)) {
-                is_binary = true;
-            }
-            if (ch == NUL) {
-                // Count for NULs in even- and odd-number bytes
-                nul_count_byte[i & 1]++;
-                if (i & 1) {
-                    if (buffer[i - 1] == NUL) {
-                        // Count for NULs in even- and odd-number words
-                        nul_count_word[(i / 2) & 1]++;
-                    }
-                }
-            }
-        }
+static int build_index(const string_vec_t& paths)
+{
+    index_t old_index;
+    if (!read_index(index_file, old_index, false)) {
+        return EXIT_FAILURE;
+    }
 
-        // Check for UTF-8 validity
-        if (is_valid_utf8) {
-            switch (utf8_char_table[ch]) {
-            case UTF8_INVALID:
-                is_valid_utf8 = false;
-                break;
-            case UTF8_1:
-                if (utf8_state != UTF8_1) {
-                    is_valid_utf8 = false;
-                }
-                break;
-            case UTF8_2:
-                if (utf8_state != UTF8_1) {
-                    is_valid_utf8 = false;
-                } else {
-                    utf8_state = UTF8_2;
-                }
-                break;
-            case UTF8_3:
-                if (utf8_state != UTF8_1) {
-                    is_valid_utf8 = false;
-                } else {
-                    utf8_state = UTF8_3;
-                }
-                break;
-            case UTF8_4:
-                if (utf8_state != UTF8_1) {
-                    is_valid_utf8 = false;
-                } else {
-                    utf8_state = UTF8_4;
-                }
-                break;
-            case UTF8_TAIL:
-                if (utf8_state > UTF8_1) {
-                    utf8_state--;
-                } else {
-                    is_valid_utf8 = false;
-                }
-                break;
-            }
+    // Indexed paths are kept and rechecked; new paths are added
+    index_map_t entries;
+    for (word32_t i = 0; i < old_index.entry_count; ++i) {
+        const word32_t* record =
+            old_index.entries + i * INDEX_ENTRY_WORDS;
+        index_entry_t& entry = entries[old_index.path(i)];
+        entry.path = old_index.path(i);
+        entry.size = get_words(record + IE_SIZE);
+        entry.mtime = get_words(record + IE_MTIME);
+        entry.enc = old_index.enc_name(record[IE_ENC]);
+        entry.confidence = record[IE_CONFIDENCE];
+    }
+    old_index.close();              // It may be replaced below
+    for (string_vec_t::const_iterator it = paths.begin();
+            it != paths.end(); ++it) {
+        if (is_in_shard(it->c_str()) && entries.find(*it) == entries.end()) {
+            index_entry_t& entry = entries[*it];
+            entry.path = *it;
+            entry.size = 0;
+            entry.mtime = 0;
+            entry.confidence = 0;
         }
+    }
 
-        // Check whether non-Latin1 characters appear
-        if (is_valid_latin1) {
-            if (ch >= 0x80 && ch < 0xa0) {
-                is_valid_latin1 = false;
+    int status = EXIT_SUCCESS;
+    size_t rechecked = 0;
+    index_map_t::iterator it = entries.begin();
+    while (it != entries.end()) {
+        index_entry_t& entry = it->second;
+        count64_t size;
+        count64_t mtime;
+        if (!stat_file(entry.path.c_str(), size, mtime)) {
+            if (verbose) {
+                printf("Removed %s\n", entry.path.c_str());
             }
+            entries.erase(it++);
+            continue;
         }
-
-        // Construct double-bytes and count
-        if (last_ch != EOF) {
-            uint16_t dbyte_char = (last_ch << 8) + ch;
-            dbyte_char_cnt_map[dbyte_char]++;
-            dbyte_cnt++;
-            if (last_ch > 0xa0 && ch > 0xa0) {
-                dbyte_hihi_cnt++;
+        if (entry.enc.empty() || entry.size != size || entry.mtime != mtime) {
+            // Only new or changed files are read
+            const char* enc = detect_file(entry.path.c_str());
+            if (enc == NULL) {
+                status = EXIT_FAILURE;
+                entries.erase(it++);
+                continue;
             }
-            last_ch = EOF;
-        } else if (ch >= 0x80) {
-            last_ch = ch;
+            entry.size = size;
+            entry.mtime = mtime;
+            entry.enc = enc;
+            entry.confidence =
+                (unsigned)(tellenc_ctx_confidence(ctx) * 100 + 0.5);
+            ++rechecked;
         }
+        ++it;
     }
 
-    // Get the character counts in descending order
-    sort(sbyte_char_cnt, sbyte_char_cnt + MAX_CHAR, greater_char_count());
-
-    // Get the double-byte counts in descending order
-    char_count_vec_t dbyte_char_cnt;
-    for (char_count_map_t::iterator it = dbyte_char_cnt_map.begin();
-            it != dbyte_char_cnt_map.end(); ++it) {
-        dbyte_char_cnt.push_back(*it);
+    if (!write_index(entries)) {
+        return EXIT_FAILURE;
     }
-    sort(dbyte_char_cnt.begin(),
-         dbyte_char_cnt.end(),
-         greater_char_count());
-
     if (verbose) {
-        print_sbyte_char_cnt(sbyte_char_cnt);
-        print_dbyte_char_cnt(dbyte_char_cnt);
-        printf("%u characters\n", (unsigned)len);
-        printf("%u double-byte characters\n", dbyte_cnt);
-        printf("%u double-byte hi-hi characters\n", dbyte_hihi_cnt);
-        printf("%u unique double-byte characters\n",
-               (unsigned)dbyte_char_cnt.size());
-    }
-
-    if (!is_valid_utf8 && is_binary) {
-        // Heuristics for UTF-16/32
-        if        (nul_count_byte[EVEN] > 4 &&
-                   (nul_count_byte[ODD] == 0 ||
-                    nul_count_byte[EVEN] / nul_count_byte[ODD] > 20)) {
-            return "utf-16";
-        } else if (nul_count_byte[ODD] > 4 &&
-                   (nul_count_byte[EVEN] == 0 ||
-                    nul_count_byte[ODD] / nul_count_byte[EVEN] > 20)) {
-            return "utf-16le";
-        } else if (nul_count_word[EVEN] > 4 &&
-                   (nul_count_word[ODD] == 0 ||
-                    nul_count_word[EVEN] / nul_count_word[ODD] > 20)) {
-            return "ucs-4";   // utf-32 is not a built-in encoding for Vim
-        } else if (nul_count_word[ODD] > 4 &&
-                   (nul_count_word[EVEN] == 0 ||
-                    nul_count_word[ODD] / nul_count_word[EVEN] > 20)) {
-            return "ucs-4le"; // utf-32le is not a built-in encoding for Vim
-        } else {
-            return "binary";
-        }
-    } else if (dbyte_cnt == 0) {
-        // No characters outside the scope of ASCII
-        return "ascii";
-    } else if (is_valid_utf8) {
-        // Only valid UTF-8 sequences
-        return "utf-8";
-    } else if (const char* enc = search_freq_dbytes(dbyte_char_cnt)) {
-        return enc;
-    } else if (dbyte_hihi_cnt * 100 / dbyte_cnt < 5) {
-        // Mostly a low-byte follows a high-byte
-        return "windows-1252";
-    }
-    return NULL;
+        printf("%u entries indexed, %u rechecked\n",
+               (unsigned)entries.size(), (unsigned)rechecked);
+    }
+    return status;
+}
+
+static void print_entry(const index_t& index, word32_t entry)
+{
+    printf("%s\t%s\t%u%%\n", index.path(entry),
+           index.enc_name(index.enc(entry)),
+           (unsigned)index.entries[entry * INDEX_ENTRY_WORDS +
+                                   IE_CONFIDENCE]);
 }
 
-const char* tellenc_simplify(const char* const buffer, const size_t len)
+static void print_summary(const index_t& index, word32_t first,
+                          word32_t last)
 {
-    const char* enc = tellenc((const unsigned char*)buffer, len);
-    if (enc) {
-        if (strcmp(enc, "windows-1252") == 0 && is_valid_latin1) {
-            // Latin1 is subset of Windows-1252
-            return "latin1";
-        } else if (strcmp(enc, "gbk") == 0 && dbyte_hihi_cnt == dbyte_cnt) {
-            // Special case for GB2312: no high-byte followed by a low-byte
-            return "gb2312";
+    for (word32_t i = 0; i < index.enc_count; ++i) {
+        const word32_t* enc = index.encs + i * INDEX_ENC_WORDS;
+        if (query_enc && strcmp(index.enc_name(i), query_enc) != 0) {
+            continue;
+        }
+        const word32_t* posting = index.postings + enc[IX_FIRST];
+        const word32_t* begin =
+            lower_bound(posting, posting + enc[IX_COUNT], first);
+        const word32_t* end =
+            lower_bound(begin, posting + enc[IX_COUNT], last);
+        double bytes = 0;
+        for (const word32_t* pos = begin; pos != end; ++pos) {
+            if (*pos < index.entry_count) {     // Unless corrupt
+                bytes += get_words(index.entries +
+                                   *pos * INDEX_ENTRY_WORDS + IE_SIZE);
+            }
+        }
+        if (begin != end) {
+            printf("%s\t%u\t%.0f\n", index.enc_name(i),
+                   (unsigned)(end - begin), bytes);
         }
     }
-    return enc;
 }
 
-static void usage()
+static int query_index(const char* filename)
 {
-    fprintf(stderr, "Usage: tellenc [-v] <filename> \n");
+    index_t index;
+    if (!read_index(filename, index, true)) {
+        return EXIT_FAILURE;
+    }
+
+    // The entries are sorted by path, so those under a prefix form one
+    // contiguous range, and each posting list is sorted as well
+    size_t prefix_len = strlen(query_prefix);
+    word32_t first = 0;
+    word32_t count = index.entry_count;
+    while (count != 0) {
+        word32_t half = count / 2;
+        if (strcmp(index.path(first + half), query_prefix) < 0) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    word32_t last = first;
+    while (last < index.entry_count &&
+           strncmp(index.path(last), query_prefix, prefix_len) == 0) {
+        ++last;
+    }
+
+    if (query_summary) {
+        print_summary(index, first, last);
+    } else if (query_enc) {
+        for (word32_t i = 0; i < index.enc_count; ++i) {
+            if (strcmp(index.enc_name(i), query_enc) != 0) {
+                continue;
+            }
+            const word32_t* enc = index.encs + i * INDEX_ENC_WORDS;
+            const word32_t* posting = index.postings + enc[IX_FIRST];
+            const word32_t* end = posting + enc[IX_COUNT];
+            const word32_t* pos = lower_bound(posting, end, first);
+            for (; pos != end && *pos < last; ++pos) {
+                print_entry(index, *pos);
+            }
+        }
+    } else {
+        for (word32_t i = first; i < last; ++i) {
+            print_entry(index, i);
+        }
+    }
+    return EXIT_SUCCESS;
 }
 
 int __cdecl main(int argc, char* argv[])
 {
-    const char* filename;
-    if (argc == 3 && strcmp(argv[1], "-v") == 0) {
-        verbose = true;
+    string_vec_t paths;
+    const char* query_file = NULL;
+    bool batch_mode = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(arg, "--sniff-declared") == 0) {
+            sniff_declared = true;
+        } else if (strncmp(arg, "--max-utf8-errors=", 18) == 0) {
+            char* end;
+            double rate = strtod(arg + 18, &end);
+            if (end == arg + 18 || *end != '\0' || !(rate >= 0 && rate <= 1)) {
+                fprintf(stderr, "Invalid error rate `%s' \n", arg + 18);
+                exit(EXIT_FAILURE);
+            }
+            max_utf8_errors = long(rate * 1e6 + 0.5);
+        } else if (strncmp(arg, "--candidates=", 13) == 0) {
+            if (!parse_candidates(arg + 13)) {
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(arg, "--stop-early") == 0) {
+            stop_early = true;
+        } else if (strcmp(arg, "--merge") == 0) {
+            if (i + 1 == argc) {
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            return merge_results(argc - i - 1, argv + i + 1);
+        } else if (strncmp(arg, "--shard=", 8) == 0) {
+            if (!parse_shard(arg + 8, shard)) {
+                fprintf(stderr, "Invalid shard `%s' \n", arg + 8);
+                exit(EXIT_FAILURE);
+            }
+            batch_mode = true;
+        } else if (strncmp(arg, "--checkpoint=", 13) == 0) {
+            checkpoint_file = arg + 13;
+            batch_mode = true;
+        } else if (strncmp(arg, "--index=", 8) == 0) {
+            index_file = arg + 8;
+            batch_mode = true;
+        } else if (strncmp(arg, "--query=", 8) == 0) {
+            query_file = arg + 8;
+        } else if (strncmp(arg, "--prefix=", 9) == 0) {
+            query_prefix = arg + 9;
+        } else if (strncmp(arg, "--encoding=", 11) == 0) {
+            query_enc = arg + 11;
+        } else if (strcmp(arg, "--summary") == 0) {
+            query_summary = true;
+        } else if (strncmp(arg, "--files-from=", 13) == 0) {
+            if (!read_file_list(arg + 13, paths)) {
+                exit(EXIT_FAILURE);
+            }
+            batch_mode = true;
+        } else if (strcmp(arg, "--") == 0) {
+            ++i;
+            break;
+        } else {
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (; i < argc; ++i) {
+        paths.push_back(argv[i]);
     }
-    if (argc != 2 && !verbose) {
+    if (query_file) {
+        // Queries never touch file contents
+        if (batch_mode || !paths.empty()) {
+            usage();
+            exit(EXIT_FAILURE);
+        }
+        return query_index(query_file);
+    }
+    if (paths.size() > 1) {
+        batch_mode = true;
+    }
+    if (paths.empty() && !batch_mode) {
         usage();
         exit(EXIT_FAILURE);
     }
-    if (verbose) {
-        filename = argv[2];
-    } else {
-        filename = argv[1];
-    }
 
-    FILE* fp = fopen(filename, "rb");
-    if (fp == NULL) {
-        fprintf(stderr, "Cannot open file `%s': %s \n",
-                        filename, strerror(errno));
+    ctx = tellenc_ctx_create();
+    if (ctx == NULL) {
+        fprintf(stderr, "Out of memory \n");
         exit(EXIT_FAILURE);
     }
+    tellenc_ctx_set_option(ctx, TELLENC_OPTION_VERBOSE, verbose);
+    tellenc_ctx_set_option(ctx, TELLENC_OPTION_SNIFF_DECLARED,
+                           sniff_declared);
+    if (max_utf8_errors >= 0) {
+        tellenc_ctx_set_option(ctx, TELLENC_OPTION_MAX_UTF8_ERRORS,
+                               max_utf8_errors);
+    }
+    if (!candidates.empty() &&
+            tellenc_ctx_set_candidates(ctx, &candidates[0],
+                                       &candidate_priors[0],
+                                       candidates.size()) != 0) {
+        fprintf(stderr, "Too many candidates \n");
+        exit(EXIT_FAILURE);
+    }
+    tellenc_ctx_set_option(ctx, TELLENC_OPTION_STOP_EARLY, stop_early);
+    if (index_file) {
+        return build_index(paths);
+    } else if (batch_mode) {
+        return scan_files(paths);
+    }
 
-    char buffer[TELLENC_BUFFER_SIZE];
-    size_t len;
-    len = fread(buffer, 1, sizeof buffer, fp);
-    fclose(fp);
-
-    init_utf8_char_table();
-    if (const char* enc = tellenc_simplify(buffer, len)) {
-        puts(enc);
-    } else {
-        puts("unknown");
+    const char* enc = detect_file(paths[0].c_str());
+    if (enc == NULL) {
+        exit(EXIT_FAILURE);
     }
+    puts(enc);
 
     return 0;
 }
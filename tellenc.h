@@ -0,0 +1,4444 @@
+﻿// vim: expandtab shiftwidth=4 softtabstop=4 tabstop=4
+
+/*
+ * Copyright (C) 2006-2016 Wu Yongwei <wuyongwei@gmail.com>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must
+ *    not claim that you wrote the original software.  If you use this
+ *    software in a product, an acknowledgement in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must
+ *    not be misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source
+ *    distribution.
+ *
+ *
+ * The latest version of this software should be available at:
+ *      <URL:https://github.com/adah1972/tellenc>
+ *
+ */
+
+/**
+ * @file    tellenc.h
+ *
+ * Header-only library to detect the encoding of text.  All state lives
+ * in a caller-owned tellenc_workspace_t, so detection uses no globals
+ * and does no heap allocation; one workspace per thread can be reused
+ * for any number of detections.  Text can be given at once with
+ * tellenc_detect, or in chunks with tellenc_begin, tellenc_feed and
+ * tellenc_finish.
+ *
+ * @version 1.22, 2016/07/26
+ * @author  Wu Yongwei
+ */
+
+#ifndef TELLENC_H
+#define TELLENC_H
+
+#include <algorithm>        // partial_sort/sort
+#include <ctype.h>          // isprint/tolower
+#include <limits.h>         // INT_MAX
+#include <math.h>           // exp/log
+#include <stddef.h>         // size_t
+#include <stdio.h>          // printf
+#include <string.h>         // memcmp/memcpy/memset/strchr/strlen
+
+#if __cplusplus >= 201103L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+#define TELLENC_NOEXCEPT noexcept
+#else
+#define TELLENC_NOEXCEPT
+#endif
+
+#if defined(__GNUC__)
+#define TELLENC_PREFETCH(ptr) __builtin_prefetch(ptr)
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>      // _mm_prefetch
+#define TELLENC_PREFETCH(ptr) \
+    _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#else
+#define TELLENC_PREFETCH(ptr) ((void)(ptr))
+#endif
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define TELLENC_HAS_STRING_VIEW 1
+#include <string_view>      // string_view
+#if defined(__has_include)
+#if __has_include(<span>) && \
+    (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#define TELLENC_HAS_SPAN 1
+#include <cstddef>          // byte
+#include <span>             // span
+#endif
+#if __has_include(<memory_resource>)
+#define TELLENC_HAS_PMR 1
+#include <memory_resource>  // pmr::memory_resource
+#include <new>              // placement new
+#endif
+#endif
+#endif
+
+// Fixed-width integers from <stdint.h> where the compiler has it, or
+// typedefs of our own; tellenc_detail has them either way, and no more
+// is declared globally
+#if __cplusplus >= 201103L || defined(__GNUC__) || \
+    (defined(_MSC_VER) && _MSC_VER >= 1600)
+#include <stdint.h>         // uint16_t/uint32_t
+namespace tellenc_detail {
+using ::uint16_t;
+using ::uint32_t;
+}
+#else
+namespace tellenc_detail {
+typedef unsigned short uint16_t;
+typedef unsigned int   uint32_t;
+}
+#endif
+
+/** Count in a whole text, which may be far beyond 4 G: 64-bit if possible. */
+#if __cplusplus >= 201103L || defined(_MSC_VER)
+typedef unsigned long long tellenc_count_t;
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wlong-long"
+typedef unsigned long long tellenc_count_t;
+#pragma GCC diagnostic pop
+#else
+typedef unsigned long tellenc_count_t;
+#endif
+
+/**
+ * Encoding identifiers.  The values are part of the C ABI in
+ * tellenc_c.h, so new encodings must only be added at the end.
+ */
+enum tellenc_encoding_t {
+    TELLENC_UNKNOWN,
+    TELLENC_BINARY,
+    TELLENC_ASCII,
+    TELLENC_UTF_8,
+    TELLENC_UTF_16,
+    TELLENC_UTF_16LE,
+    TELLENC_UCS_4,
+    TELLENC_UCS_4LE,
+    TELLENC_LATIN1,
+    TELLENC_WINDOWS_1250,
+    TELLENC_WINDOWS_1252,
+    TELLENC_CP437,
+    TELLENC_GB2312,
+    TELLENC_GBK,
+    TELLENC_BIG5,
+    TELLENC_SJIS,
+    TELLENC_EUC_JP,
+    TELLENC_EUC_KR,
+    TELLENC_KOI8_R,
+    TELLENC_KOI8_U,
+    TELLENC_ISO_2022_JP,
+    TELLENC_ISO_2022_JP_2,
+    TELLENC_ISO_2022_KR,
+    TELLENC_ISO_2022_CN,
+    TELLENC_HZ,
+    TELLENC_UTF_7,
+    TELLENC_GB18030,
+    TELLENC_WINDOWS_1251,
+    TELLENC_CP866,
+    TELLENC_ISO_8859_5,
+    TELLENC_MAC_CYRILLIC,
+    TELLENC_WINDOWS_1253,
+    TELLENC_ISO_8859_7,
+    TELLENC_WINDOWS_1255,
+    TELLENC_ISO_8859_8,
+    TELLENC_WINDOWS_1256,
+    TELLENC_TIS_620,
+    TELLENC_ENCODING_COUNT
+};
+
+/**
+ * Languages, identified along with the encoding.  Like the encodings,
+ * new languages must only be added at the end.
+ */
+enum tellenc_language_t {
+    TELLENC_LANG_UNKNOWN,
+    TELLENC_LANG_EN,
+    TELLENC_LANG_FR,
+    TELLENC_LANG_DE,
+    TELLENC_LANG_ES,
+    TELLENC_LANG_FI,
+    TELLENC_LANG_CS,
+    TELLENC_LANG_SK,
+    TELLENC_LANG_SL,
+    TELLENC_LANG_HU,
+    TELLENC_LANG_PL,
+    TELLENC_LANG_RU,
+    TELLENC_LANG_UK,
+    TELLENC_LANG_EL,
+    TELLENC_LANG_HE,
+    TELLENC_LANG_AR,
+    TELLENC_LANG_TH,
+    TELLENC_LANG_ZH,
+    TELLENC_LANG_JA,
+    TELLENC_LANG_KO,
+    TELLENC_LANGUAGE_COUNT
+};
+
+/** Line endings of a text. */
+enum tellenc_line_ending_t {
+    TELLENC_EOL_NONE,       ///< A single line
+    TELLENC_EOL_LF,
+    TELLENC_EOL_CRLF,
+    TELLENC_EOL_CR,
+    TELLENC_EOL_MIXED
+};
+
+/**
+ * Properties of the lines of a text, counted in the same scan as the
+ * encoding.  The bytes are taken as ASCII, so they are only meaningful
+ * for ASCII-compatible encodings.
+ */
+struct tellenc_text_info_t {
+    tellenc_line_ending_t line_ending;
+    tellenc_count_t lf_count;       ///< LFs not after a CR
+    tellenc_count_t crlf_count;
+    tellenc_count_t cr_count;       ///< CRs not before an LF
+    tellenc_count_t tab_count;
+    tellenc_count_t tab_indented;   ///< Lines starting with a tab
+    tellenc_count_t space_indented; ///< Lines starting with a space
+    bool            has_bom;
+    bool            has_final_newline;
+    bool            has_dos_eof;    ///< Ends with a Ctrl-Z
+};
+
+/**
+ * Policies of the encodings a detection may report, for the templates
+ * like tellenc_detect<tellenc_chinese_encodings>.  A policy has an inline
+ * static function \c enabled, so that the checks and tables for the
+ * other encodings are removed at compile time.  Unknown and binary can
+ * always be reported.
+ */
+struct tellenc_all_encodings {
+    static bool enabled(tellenc_encoding_t) { return true; }
+};
+
+/** UTF-8, GB2312, GBK, GB18030, Big5 and ASCII. */
+struct tellenc_chinese_encodings {
+    static bool enabled(tellenc_encoding_t enc)
+    {
+        return enc == TELLENC_ASCII || enc == TELLENC_UTF_8 ||
+               enc == TELLENC_GB2312 || enc == TELLENC_GBK ||
+               enc == TELLENC_GB18030 || enc == TELLENC_BIG5;
+    }
+};
+
+/** UTF-8, Latin1, Windows-1252 and ASCII. */
+struct tellenc_western_encodings {
+    static bool enabled(tellenc_encoding_t enc)
+    {
+        return enc == TELLENC_ASCII || enc == TELLENC_UTF_8 ||
+               enc == TELLENC_LATIN1 || enc == TELLENC_WINDOWS_1252;
+    }
+};
+
+namespace tellenc_detail {
+
+static const size_t MAX_CHAR = 256;
+static const size_t MAX_DBYTE = 0x8000;     // the first byte is >= 0x80
+static const size_t MAX_COMP_IDX = 10;
+static const size_t PREFETCH_DISTANCE = 2;  // buffers ahead in a batch
+static const size_t PREFETCH_BYTES = 256;   // from the start of a buffer
+static const size_t CACHE_LINE = 64;
+static const size_t MAX_DETECTORS = 8;      // added to a workspace
+static const size_t MIN_UTF16_UNITS = 8;
+static const uint32_t MIN_UTF16_CONFIDENCE = 95;    // percent
+static const uint32_t MIN_UCS4_PRINTABLE = 90;      // percent
+static const int SBYTE_BIGRAM_WEIGHT = 20;
+static const double MIN_SBYTE_SCORE = 15;   // per high byte
+static const double MIN_DOUBLE_ENCODED_RATIO = 0.5;
+static const size_t DECL_SNIFF_BYTES = 4096;    // searched for a charset
+static const size_t MAX_CHARSET_NAME = 40;
+static const size_t CANDIDATE_CHECK_BYTES = 4096;   // scanned between checks
+static const size_t MAX_SCAN_BLOCK = 1 << 30;   // scanned between flushes
+static const uint32_t MAX_DBYTE_COUNT = 0xffffffff;
+static const size_t MAX_LANGUAGE_CP = 0x800;    // counted one by one
+static const size_t LANGUAGE_BLOCKS = 0x400;    // of 64 code points
+static const uint32_t MIN_LANGUAGE_LETTERS = 32;
+static const double UNMODELED_LETTER_RATE = 1e-5;
+static const size_t MAX_UTF8_ERROR_OFFSETS = 8;     // kept in a workspace
+static const uint32_t MIN_UTF8_ERRORS_TO_STOP = 16;
+static const double DEFAULT_MAX_UTF8_ERROR_RATE = 0.05;
+static const size_t DBYTE_SKETCH_SIZE = 64;     // double-bytes kept
+
+/** Classes of UTF-16 code units, by their high bytes. */
+enum UTF16_Class {
+    UTF16_OTHER,
+    UTF16_BASIC,            ///< U+00xx and U+20xx (punctuation)
+    UTF16_CJK,              ///< CJK, kana, hangul and full-width forms
+    UTF16_HIGH_SURROGATE,
+    UTF16_LOW_SURROGATE,
+    UTF16_CLASS_COUNT
+};
+
+/** Families of legacy double-byte encodings, by their byte structure. */
+enum DBCS_Family {
+    DBCS_SJIS,
+    DBCS_EUC_JP,
+    DBCS_EUC,               ///< EUC-KR and GB2312
+    DBCS_GBK,               ///< Also GB18030, whose digits pass as trails
+    DBCS_BIG5,              ///< Without the HKSCS leads 81-A0 and C8
+    DBCS_FAMILY_COUNT
+};
+
+static const unsigned char DBCS_ALL = (1 << DBCS_FAMILY_COUNT) - 1;
+
+/** Bytes seen of a possible four-byte sequence of GB18030. */
+enum GB4_State {
+    GB4_NONE,
+    GB4_DIGIT,              ///< A high byte and a digit
+    GB4_THIRD               ///< And another high byte
+};
+
+static const int UTF16_BE = 0;
+static const int UTF16_LE = 1;
+static const int UCS4_BE = 0;
+static const int UCS4_LE = 1;
+
+/** Encodings told by escape sequences or shifts, in 7-bit text. */
+enum Escape_Kind {
+    ESC_ISO_2022_JP,
+    ESC_ISO_2022_JP_2,
+    ESC_ISO_2022_KR,
+    ESC_ISO_2022_CN,
+    ESC_HZ,
+    ESC_UTF_7,
+    ESC_KIND_COUNT
+};
+
+/** What a byte flagged in escape_char_table has started. */
+enum Escape_State {
+    ESC_NONE,
+    ESC_SEQ,                ///< ESC, followed by esc_seq
+    ESC_TILDE,              ///< '~' of HZ
+    ESC_PLUS                ///< '+' of UTF-7
+};
+
+enum Escape_Mode {
+    ESC_MODE_ASCII,
+    ESC_MODE_DBCS,          ///< After ESC $ B, etc.
+    ESC_MODE_SHIFT_OUT,     ///< After SO of ISO-2022-KR/CN
+    ESC_MODE_HZ,            ///< After ~{
+    ESC_MODE_UTF7,          ///< After +, in base64
+    ESC_MODE_COUNT
+};
+
+} // namespace tellenc_detail
+
+struct tellenc_workspace_t;
+
+/** Evidence a detector reads from the workspace. */
+enum tellenc_evidence_t {
+    TELLENC_EVIDENCE_HEAD = 1,          ///< The first bytes, in \c head
+    TELLENC_EVIDENCE_COUNTS = 2,        ///< The statistics of the scan
+    TELLENC_EVIDENCE_DBYTE_RANK = 4     ///< \c dbyte_chars sorted
+};
+
+/**
+ * A detector, which tells an encoding from the evidence gathered by the
+ * scan.  The detectors run from the cheapest one, as soon as their
+ * evidence is available, until one of them returns an encoding.
+ */
+struct tellenc_detector_t {
+    const char*     name;
+    unsigned        cost;       ///< Relative cost; ties run in added order
+    unsigned        evidence;   ///< tellenc_evidence_t flags needed
+
+    /// Returns the encoding, or TELLENC_UNKNOWN if not decided
+    tellenc_encoding_t (*detect)(const tellenc_workspace_t& ws);
+};
+
+/**
+ * Space-Saving summary of the most frequent double-bytes, in fixed
+ * memory: a double-byte that makes up more than 1/DBYTE_SKETCH_SIZE of
+ * all is sure to be kept.  A count is never below the real one, and is
+ * above it by at most the error.  Summaries of parts of a text can be
+ * merged with tellenc_merge_dbyte_sketch.
+ */
+struct tellenc_dbyte_sketch_t {
+    tellenc_detail::uint32_t size;  ///< Entries in use
+    tellenc_detail::uint16_t dbytes[tellenc_detail::DBYTE_SKETCH_SIZE];
+    tellenc_count_t counts[tellenc_detail::DBYTE_SKETCH_SIZE];
+    tellenc_count_t errors[tellenc_detail::DBYTE_SKETCH_SIZE];
+    /// Entries as a min-heap on the counts, and the place of each in it
+    unsigned char heap[tellenc_detail::DBYTE_SKETCH_SIZE];
+    unsigned char heap_pos[tellenc_detail::DBYTE_SKETCH_SIZE];
+    /// Entries chained by a hash of the double-byte, plus one (0 ends)
+    unsigned char buckets[256];
+    unsigned char next[tellenc_detail::DBYTE_SKETCH_SIZE];
+};
+
+/**
+ * Scratch memory and statistics of a detection.  It is large (about
+ * 240 KB), so it should be allocated statically or on the heap, and
+ * reused.  The statistics remain valid until the next detection.
+ */
+struct tellenc_workspace_t {
+    tellenc_workspace_t()
+    {
+        verbose = false;
+        sniff_declared = false;
+        max_utf8_error_rate = tellenc_detail::DEFAULT_MAX_UTF8_ERROR_RATE;
+        for (int i = 0; i < TELLENC_ENCODING_COUNT; ++i) {
+            is_candidate[i] = true;
+            priors[i] = 1;
+        }
+        max_prior = 1;
+        has_candidates = false;
+        stop_early = false;
+        use_dbyte_sketch = false;
+        dbyte_sketch.size = 0;
+        memset(dbyte_sketch.buckets, 0, sizeof dbyte_sketch.buckets);
+        decl_len = 0;
+        declared_enc = TELLENC_UNKNOWN;
+        memset(lang_cp_cnt, 0, sizeof lang_cp_cnt);
+        memset(lang_block_cnt, 0, sizeof lang_block_cnt);
+        lang_slot_cnt = 0;
+        memset(dbyte_char_cnt, 0, sizeof dbyte_char_cnt);
+        dbyte_uniq_cnt = 0;
+        dbyte_scale = 0;
+        dbyte_count_bound = 0;
+        pos = 0;
+        head_len = 0;
+        head_enc = TELLENC_UNKNOWN;
+        sole_enc = TELLENC_UNKNOWN;
+        detector_count = 0;
+    }
+
+    bool        verbose;    ///< Print the statistics to stdout
+    bool        sniff_declared; ///< Trust a declared charset (off)
+    /// UTF-8 with a smaller share of invalid sequences is still UTF-8
+    double      max_utf8_error_rate;
+
+    // Encodings that may be reported, and their weights against each
+    // other; set by tellenc_set_candidates
+    bool        is_candidate[TELLENC_ENCODING_COUNT];
+    double      priors[TELLENC_ENCODING_COUNT];
+    double      max_prior;
+    bool        has_candidates;     ///< Some encodings are left out
+    /// Stop the scan when one candidate is left (off); the rest of the
+    /// text is then not looked at
+    bool        stop_early;
+    /// Count the double-bytes in dbyte_sketch instead of dbyte_char_cnt
+    bool        use_dbyte_sketch;
+
+    // Scanning state, kept between tellenc_feed calls
+    tellenc_count_t pos;
+    int         utf8_state;
+    int         last_ch;
+    int         gb4_state;
+    unsigned char gb4_bytes[3];     ///< Of a possible GB18030 sequence
+    unsigned char prev_ch;
+    unsigned char head[4];
+    size_t      head_len;
+    tellenc_encoding_t head_enc;    ///< Decided by the first bytes
+    tellenc_encoding_t sole_enc;    ///< The only candidate left early
+
+    // The first bytes, searched for a declared charset
+    unsigned char decl_buf[tellenc_detail::DECL_SNIFF_BYTES];
+    size_t      decl_len;
+    tellenc_encoding_t declared_enc;
+
+    tellenc_count_t nul_count_byte[2];
+    tellenc_count_t nul_count_word[2];
+    bool        is_binary;
+    bool        is_valid_utf8;
+    bool        is_mostly_utf8;     ///< Still checked despite errors
+    tellenc_count_t utf8_errors;        ///< Invalid sequences
+    tellenc_count_t utf8_error_end;     ///< Of the last one
+    /// Offsets of the first invalid sequences
+    tellenc_count_t utf8_error_offsets[
+                        tellenc_detail::MAX_UTF8_ERROR_OFFSETS];
+    bool        is_valid_latin1;
+
+    // Lead and trail bytes of the double-byte families, as bits of
+    // DBCS_Family; a character cut at the end is not an error
+    unsigned char dbcs_valid;       ///< Families that fit the text
+    unsigned char dbcs_pending;     ///< Expecting a trail byte
+    unsigned char dbcs_pending2;    ///< Expecting two trail bytes
+
+    // Line endings and indentation; LFs, CRs and tabs are in sbyte_char_cnt
+    tellenc_count_t crlf_cnt;
+    tellenc_count_t tab_indent_cnt;     ///< Lines starting with a tab
+    tellenc_count_t space_indent_cnt;   ///< Lines starting with a space
+    bool        is_line_start;
+    tellenc_count_t eol_end;            ///< Offset after the last line end
+
+    // Non-ASCII UTF-8 characters, and those of UTF-8 that was decoded as
+    // Windows-1252 (or Latin1) and encoded again
+    tellenc_detail::uint32_t utf8_cp;   ///< Of the character being decoded
+    tellenc_count_t utf8_char_start;
+    tellenc_count_t utf8_char_end;      ///< Of the last non-ASCII character
+    int         utf8_double_need;   ///< Characters still to come
+    /// Characters of the sequence so far
+    tellenc_detail::uint32_t utf8_double_run;
+    tellenc_count_t utf8_char_cnt;
+    tellenc_count_t utf8_double_cnt;
+
+    // Non-ASCII letters, in lowercase, for the language
+    tellenc_count_t lang_cp_cnt[tellenc_detail::MAX_LANGUAGE_CP];
+    tellenc_count_t lang_block_cnt[tellenc_detail::LANGUAGE_BLOCKS];
+    /// Counts in use, so that only they need to be cleared: code points,
+    /// or MAX_LANGUAGE_CP plus the block
+    tellenc_detail::uint16_t lang_slots[tellenc_detail::MAX_LANGUAGE_CP +
+                                        tellenc_detail::LANGUAGE_BLOCKS];
+    tellenc_detail::uint32_t lang_slot_cnt;
+    tellenc_language_t language;    ///< Likely language of the text
+    double      language_confidence;
+
+    /// Detector that decided the encoding, or NULL if none did
+    const tellenc_detector_t* decided_by;
+    double      confidence;         ///< Of the encoding, from 0 to 1
+
+    tellenc_count_t dbyte_cnt;
+    tellenc_count_t dbyte_hihi_cnt;
+    tellenc_detail::uint32_t dbyte_uniq_cnt;
+    tellenc_count_t gb18030_cnt;        ///< Four-byte sequences
+    tellenc_count_t gb18030_errors;     ///< Broken ones
+    tellenc_count_t sbyte_char_cnt[tellenc_detail::MAX_CHAR];
+    /// Counts of double-bytes, kept 32-bit for the cache, so divided by
+    /// 2 to the dbyte_scale when a long text could overflow them
+    tellenc_detail::uint32_t dbyte_char_cnt[tellenc_detail::MAX_DBYTE];
+    int         dbyte_scale;
+    tellenc_count_t dbyte_count_bound; ///< Of any dbyte_char_cnt entry
+    /// Frequent double-bytes, copied to dbyte_char_cnt at the end
+    tellenc_dbyte_sketch_t dbyte_sketch;
+
+    /// Double-bytes seen, most frequent first after a detection
+    tellenc_detail::uint16_t dbyte_chars[tellenc_detail::MAX_DBYTE];
+
+    // UTF-16 code units at even positions, in both byte orders
+    tellenc_count_t utf16_class_cnt[2][tellenc_detail::UTF16_CLASS_COUNT];
+    tellenc_count_t utf16_surrogate_errors[2];
+    bool        utf16_in_pair[2];   ///< After a high surrogate
+    tellenc_count_t utf16_latin_cnt;    ///< Units of ASCII letters or spaces
+
+    // UCS-4 code units, in both byte orders, checked until neither is valid
+    tellenc_detail::uint32_t ucs4_word; ///< The last four bytes
+    bool        ucs4_valid[2];      ///< No surrogates or beyond 0x10FFFF
+    tellenc_count_t ucs4_printable_cnt[2];
+
+    // Escape sequences and shifts, checked while the text is 7-bit
+    bool        is_7bit;
+    unsigned char esc_state;
+    unsigned char esc_mode;
+    unsigned char esc_seq[3];
+    size_t      esc_seq_len;
+    bool        esc_half;           ///< After a first byte of a DBCS
+    bool        esc_so_designated;  ///< SO may be used
+    tellenc_detail::uint32_t utf7_bits;
+    tellenc_detail::uint32_t utf7_bit_cnt;
+    bool        utf7_has_unit;
+    int         utf7_script;        ///< Of the run so far, or -1 if none
+    tellenc_count_t esc_cnt[tellenc_detail::ESC_KIND_COUNT];
+    tellenc_count_t iso2022_errors;
+    tellenc_count_t hz_errors;
+    tellenc_count_t utf7_errors;
+
+    /// Detectors added with tellenc_add_detector
+    const tellenc_detector_t* detectors[tellenc_detail::MAX_DETECTORS];
+    size_t      detector_count;
+
+private:
+    tellenc_workspace_t(const tellenc_workspace_t&);
+    tellenc_workspace_t& operator=(const tellenc_workspace_t&);
+};
+
+namespace tellenc_detail {
+
+struct greater_dbyte_count {
+    explicit greater_dbyte_count(const uint32_t* cnt) : counts(cnt) {}
+    bool operator()(uint16_t lhs, uint16_t rhs) const
+    {
+        uint32_t lhs_count = counts[lhs - MAX_DBYTE];
+        uint32_t rhs_count = counts[rhs - MAX_DBYTE];
+        if (lhs_count != rhs_count) {
+            return lhs_count > rhs_count;
+        }
+        return lhs < rhs;
+    }
+    const uint32_t* counts;
+};
+
+struct greater_sbyte_count {
+    explicit greater_sbyte_count(const tellenc_count_t* cnt) : counts(cnt)
+    {
+    }
+    bool operator()(unsigned char lhs, unsigned char rhs) const
+    {
+        if (counts[lhs] != counts[rhs]) {
+            return counts[lhs] > counts[rhs];
+        }
+        return lhs < rhs;
+    }
+    const tellenc_count_t* counts;
+};
+
+enum UTF8_State {
+    UTF8_INVALID,
+    UTF8_1,
+    UTF8_2,
+    UTF8_3,
+    UTF8_4,
+    UTF8_TAIL
+};
+
+static const unsigned char NON_TEXT_CHARS[] = { 0, 26, 127, 255 };
+static const char NUL = '\0';
+static const char DOS_EOF = '\x1A';
+static const int EVEN = 0;
+static const int ODD  = 1;
+
+#define TELLENC_X8(x) x, x, x, x, x, x, x, x
+#define TELLENC_X16(x) TELLENC_X8(x), TELLENC_X8(x)
+
+static const unsigned char utf8_char_table[MAX_CHAR] = {
+    UTF8_INVALID, UTF8_1, UTF8_1, UTF8_1,                   // 00-03
+    UTF8_1, UTF8_1, UTF8_1, UTF8_1,                         // 04-07
+    TELLENC_X8(UTF8_1),                                     // 08-0F
+    TELLENC_X16(UTF8_1), TELLENC_X16(UTF8_1),               // 10-2F
+    TELLENC_X16(UTF8_1), TELLENC_X16(UTF8_1),               // 30-4F
+    TELLENC_X16(UTF8_1), TELLENC_X16(UTF8_1),               // 50-6F
+    TELLENC_X16(UTF8_1),                                    // 70-7F
+    TELLENC_X16(UTF8_TAIL), TELLENC_X16(UTF8_TAIL),         // 80-9F
+    TELLENC_X16(UTF8_TAIL), TELLENC_X16(UTF8_TAIL),         // A0-BF
+    UTF8_INVALID, UTF8_INVALID, UTF8_2, UTF8_2,             // C0-C3
+    UTF8_2, UTF8_2, UTF8_2, UTF8_2,                         // C4-C7
+    TELLENC_X8(UTF8_2), TELLENC_X16(UTF8_2),                // C8-DF
+    TELLENC_X16(UTF8_3),                                    // E0-EF
+    UTF8_4, UTF8_4, UTF8_4, UTF8_4,                         // F0-F3
+    UTF8_4, UTF8_INVALID, UTF8_INVALID, UTF8_INVALID,       // F4-F7
+    TELLENC_X8(UTF8_INVALID)                                // F8-FF
+};
+
+static const unsigned char utf16_class_table[MAX_CHAR] = {
+    UTF16_BASIC, UTF16_OTHER, UTF16_OTHER, UTF16_OTHER,     // 00-03
+    UTF16_OTHER, UTF16_OTHER, UTF16_OTHER, UTF16_OTHER,     // 04-07
+    TELLENC_X8(UTF16_OTHER), TELLENC_X16(UTF16_OTHER),      // 08-1F
+    UTF16_BASIC, UTF16_OTHER, UTF16_OTHER, UTF16_OTHER,     // 20-23
+    UTF16_OTHER, UTF16_OTHER, UTF16_OTHER, UTF16_OTHER,     // 24-27
+    TELLENC_X8(UTF16_OTHER),                                // 28-2F
+    TELLENC_X16(UTF16_CJK), TELLENC_X16(UTF16_CJK),         // 30-4F
+    TELLENC_X16(UTF16_CJK), TELLENC_X16(UTF16_CJK),         // 50-6F
+    TELLENC_X16(UTF16_CJK), TELLENC_X16(UTF16_CJK),         // 70-8F
+    TELLENC_X16(UTF16_CJK),                                 // 90-9F
+    TELLENC_X8(UTF16_OTHER),                                // A0-A7
+    UTF16_OTHER, UTF16_OTHER, UTF16_OTHER, UTF16_OTHER,     // A8-AB
+    UTF16_CJK, UTF16_CJK, UTF16_CJK, UTF16_CJK,             // AC-AF
+    TELLENC_X16(UTF16_CJK), TELLENC_X16(UTF16_CJK),         // B0-CF
+    TELLENC_X8(UTF16_CJK),                                  // D0-D7
+    UTF16_HIGH_SURROGATE, UTF16_HIGH_SURROGATE,             // D8-D9
+    UTF16_HIGH_SURROGATE, UTF16_HIGH_SURROGATE,             // DA-DB
+    UTF16_LOW_SURROGATE, UTF16_LOW_SURROGATE,               // DC-DD
+    UTF16_LOW_SURROGATE, UTF16_LOW_SURROGATE,               // DE-DF
+    TELLENC_X16(UTF16_OTHER),                               // E0-EF
+    TELLENC_X8(UTF16_OTHER),                                // F0-F7
+    UTF16_OTHER, UTF16_CJK, UTF16_CJK, UTF16_OTHER,         // F8-FB
+    UTF16_OTHER, UTF16_OTHER, UTF16_CJK, UTF16_CJK          // FC-FF
+};
+
+/** Classes of bytes in the double-byte families. */
+enum DBCS_Class {
+    DBCS_C_ASCII,
+    DBCS_C_DIGIT,           ///< Also in four-byte sequences of GB18030
+    DBCS_C_LOW,             ///< 40-7E
+    DBCS_C_80,
+    DBCS_C_LEAD,            ///< 81-8D and 90-9F
+    DBCS_C_8E,              ///< Also half-width katakana in EUC-JP
+    DBCS_C_8F,              ///< Also JIS X 0212 in EUC-JP
+    DBCS_C_A0,
+    DBCS_C_KANA,            ///< A1-DF, half-width katakana in SJIS
+    DBCS_C_C8,              ///< Not a lead byte in Big5
+    DBCS_C_HIGH,            ///< E0-FC
+    DBCS_C_FD,              ///< FD-FE
+    DBCS_C_FF
+};
+
+/** Bits of the families where a class of bytes is valid. */
+struct dbcs_class_info {
+    unsigned char start;    ///< Alone or as the first byte
+    unsigned char lead;     ///< Before trail bytes
+    unsigned char lead3;    ///< Before two trail bytes
+    unsigned char trail;
+};
+
+#define TELLENC_S (1 << DBCS_SJIS)
+#define TELLENC_J (1 << DBCS_EUC_JP)
+#define TELLENC_E (1 << DBCS_EUC)
+#define TELLENC_G (1 << DBCS_GBK)
+#define TELLENC_B (1 << DBCS_BIG5)
+
+static const dbcs_class_info dbcs_classes[] = {
+    { DBCS_ALL, 0, 0, 0 },                                      // ASCII
+    { DBCS_ALL, 0, 0, TELLENC_G },                              // DIGIT
+    { DBCS_ALL, 0, 0, TELLENC_S | TELLENC_G | TELLENC_B },      // LOW
+    { 0, 0, 0, TELLENC_S | TELLENC_G },                         // 80
+    { TELLENC_S | TELLENC_G, TELLENC_S | TELLENC_G, 0,
+      TELLENC_S | TELLENC_G },                                  // LEAD
+    { TELLENC_S | TELLENC_J | TELLENC_G,
+      TELLENC_S | TELLENC_J | TELLENC_G, 0,
+      TELLENC_S | TELLENC_G },                                  // 8E
+    { TELLENC_S | TELLENC_J | TELLENC_G,
+      TELLENC_S | TELLENC_J | TELLENC_G, TELLENC_J,
+      TELLENC_S | TELLENC_G },                                  // 8F
+    { TELLENC_G, TELLENC_G, 0, TELLENC_S | TELLENC_G },         // A0
+    { DBCS_ALL, TELLENC_J | TELLENC_E | TELLENC_G | TELLENC_B, 0,
+      DBCS_ALL },                                               // KANA
+    { TELLENC_S | TELLENC_J | TELLENC_E | TELLENC_G,
+      TELLENC_J | TELLENC_E | TELLENC_G, 0, DBCS_ALL },         // C8
+    { DBCS_ALL, DBCS_ALL, 0, DBCS_ALL },                        // HIGH
+    { TELLENC_J | TELLENC_E | TELLENC_G | TELLENC_B,
+      TELLENC_J | TELLENC_E | TELLENC_G | TELLENC_B, 0,
+      TELLENC_J | TELLENC_E | TELLENC_G | TELLENC_B },          // FD
+    { 0, 0, 0, 0 }                                              // FF
+};
+
+#undef TELLENC_B
+#undef TELLENC_G
+#undef TELLENC_E
+#undef TELLENC_J
+#undef TELLENC_S
+
+static const unsigned char dbcs_class_table[MAX_CHAR] = {
+    TELLENC_X16(DBCS_C_ASCII), TELLENC_X16(DBCS_C_ASCII),   // 00-1F
+    TELLENC_X16(DBCS_C_ASCII),                              // 20-2F
+    TELLENC_X8(DBCS_C_DIGIT), DBCS_C_DIGIT, DBCS_C_DIGIT,   // 30-39
+    DBCS_C_ASCII, DBCS_C_ASCII, DBCS_C_ASCII,               // 3A-3C
+    DBCS_C_ASCII, DBCS_C_ASCII, DBCS_C_ASCII,               // 3D-3F
+    TELLENC_X16(DBCS_C_LOW), TELLENC_X16(DBCS_C_LOW),       // 40-5F
+    TELLENC_X16(DBCS_C_LOW), TELLENC_X8(DBCS_C_LOW),        // 60-77
+    DBCS_C_LOW, DBCS_C_LOW, DBCS_C_LOW, DBCS_C_LOW,         // 78-7B
+    DBCS_C_LOW, DBCS_C_LOW, DBCS_C_LOW, DBCS_C_ASCII,       // 7C-7F
+    DBCS_C_80, DBCS_C_LEAD, DBCS_C_LEAD, DBCS_C_LEAD,       // 80-83
+    DBCS_C_LEAD, DBCS_C_LEAD, DBCS_C_LEAD, DBCS_C_LEAD,     // 84-87
+    DBCS_C_LEAD, DBCS_C_LEAD, DBCS_C_LEAD, DBCS_C_LEAD,     // 88-8B
+    DBCS_C_LEAD, DBCS_C_LEAD, DBCS_C_8E, DBCS_C_8F,         // 8C-8F
+    TELLENC_X16(DBCS_C_LEAD),                               // 90-9F
+    DBCS_C_A0, DBCS_C_KANA, DBCS_C_KANA, DBCS_C_KANA,       // A0-A3
+    DBCS_C_KANA, DBCS_C_KANA, DBCS_C_KANA, DBCS_C_KANA,     // A4-A7
+    TELLENC_X8(DBCS_C_KANA),                                // A8-AF
+    TELLENC_X16(DBCS_C_KANA), TELLENC_X8(DBCS_C_KANA),      // B0-C7
+    DBCS_C_C8, DBCS_C_KANA, DBCS_C_KANA, DBCS_C_KANA,       // C8-CB
+    DBCS_C_KANA, DBCS_C_KANA, DBCS_C_KANA, DBCS_C_KANA,     // CC-CF
+    TELLENC_X16(DBCS_C_KANA),                               // D0-DF
+    TELLENC_X16(DBCS_C_HIGH),                               // E0-EF
+    TELLENC_X8(DBCS_C_HIGH),                                // F0-F7
+    DBCS_C_HIGH, DBCS_C_HIGH, DBCS_C_HIGH, DBCS_C_HIGH,     // F8-FB
+    DBCS_C_HIGH, DBCS_C_FD, DBCS_C_FD, DBCS_C_FF            // FC-FF
+};
+
+/** Bytes that may start an escape sequence or a shift, or are 8-bit. */
+static const unsigned char escape_char_table[MAX_CHAR] = {
+    TELLENC_X8(0), 0, 0, 0, 0, 0, 0, 1, 1,                  // 00-0F (SO/SI)
+    TELLENC_X8(0), 0, 0, 0, 1, 0, 0, 0, 0,                  // 10-1F (ESC)
+    TELLENC_X8(0), 0, 0, 0, 1, 0, 0, 0, 0,                  // 20-2F ('+')
+    TELLENC_X16(0), TELLENC_X16(0),                         // 30-4F
+    TELLENC_X8(0), 0, 0, 0, 0, 1, 0, 0, 0,                  // 50-5F ('\\')
+    TELLENC_X16(0),                                         // 60-6F
+    TELLENC_X8(0), 0, 0, 0, 0, 0, 0, 1, 0,                  // 70-7F ('~')
+    TELLENC_X16(1), TELLENC_X16(1), TELLENC_X16(1),         // 80-AF
+    TELLENC_X16(1), TELLENC_X16(1), TELLENC_X16(1),         // B0-DF
+    TELLENC_X16(1), TELLENC_X16(1)                          // E0-FF
+};
+
+#undef TELLENC_X16
+#undef TELLENC_X8
+
+/** Characters of the bytes 0x80-0x9F in Windows-1252; 0 if undefined. */
+static const uint16_t windows_1252_chars[32] = {
+    0x20ac, 0,      0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021, // 80-87
+    0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0,      0x017d, 0,      // 88-8F
+    0,      0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, // 90-97
+    0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0,      0x017e, 0x0178  // 98-9F
+};
+
+static const uint16_t freq_windows_1250[] = {
+    0x9a74,     // "št" (Czech)
+    0xe865,     // "če" (Czech)
+    0xf865,     // "ře" (Czech)
+    0xe167,     // "ág" (Hungarian)
+    0xe96c,     // "él" (Hungarian)
+    0xb36f,     // "ło" (Polish)
+    0xea7a,     // "ęz" (Polish)
+    0xf377,     // "ów" (Polish)
+    0x9d20,     // "ť " (Slovak)
+    0xfa9d,     // "úť" (Slovak)
+    0x9e69,     // "ži" (Slovenian)
+    0xe869,     // "či" (Slovenian)
+};
+
+static const uint16_t freq_windows_1252[] = {
+    0xe020,     // "à " (French)
+    0xe920,     // "é " (French)
+    0xe963,     // "éc" (French)
+    0xe965,     // "ée" (French)
+    0xe972,     // "ér" (French)
+    0xe4e4,     // "ää" (Finnish)
+    0xe474,     // "ät" (German)
+    0xfc72,     // "ür" (German)
+    0xed6e,     // "ín" (Spanish)
+    0xf36e,     // "ón" (Spanish)
+};
+
+static const uint16_t freq_cp437[] = {
+    0x8220,     // "é " (French)
+    0x8263,     // "éc" (French)
+    0x8265,     // "ée" (French)
+    0x8272,     // "ér" (French)
+    0x8520,     // "à " (French)
+    0x8172,     // "ür" (German)
+    0x8474,     // "ät" (German)
+    0xc4c4,     // "──"
+    0xcdcd,     // "══"
+    0xdbdb,     // "██"
+};
+
+static const uint16_t freq_gbk[] = {
+    0xa1a1,     // "　"
+    0xa1a2,     // "、"
+    0xa1a3,     // "。"
+    0xa1a4,     // "·"
+    0xa1b6,     // "《"
+    0xa1b7,     // "》"
+    0xa3ac,     // "，"
+    0xa3ba,     // "："
+    0xb5c4,     // "的"
+    0xc1cb,     // "了"
+    0xd2bb,     // "一"
+    0xcac7,     // "是"
+    0xb2bb,     // "不"
+    0xb8f6,     // "个"
+    0xc8cb,     // "人"
+    0xd5e2,     // "这"
+    0xd3d0,     // "有"
+    0xced2,     // "我"
+    0xc4e3,     // "你"
+    0xcbfb,     // "他"
+    0xcbfd,     // "她"
+    0xc9cf,     // "上"
+    0xbfb4,     // "看"
+    0xd6ae,     // "之"
+    0xbbb9,     // "还"
+    0xbfc9,     // "可"
+    0xbaf3,     // "后"
+    0xd6d0,     // "中"
+    0xd0d0,     // "行"
+    0xb1d2,     // "币"
+    0xb3f6,     // "出"
+    0xb7d1,     // "费"
+    0xb8d0,     // "感"
+    0xbef5,     // "觉"
+    0xc4ea,     // "年"
+    0xd4c2,     // "月"
+    0xc8d5,     // "日"
+};
+
+static const uint16_t freq_big5[] = {
+    0xa140,     // "　"
+    0xa141,     // "，"
+    0xa143,     // "。"
+    0xa147,     // "："
+    0xaaba,     // "的"
+    0xa446,     // "了"
+    0xa440,     // "一"
+    0xac4f,     // "是"
+    0xa4a3,     // "不"
+    0xa448,     // "人"
+    0xa7da,     // "我"
+    0xa741,     // "你"
+    0xa54c,     // "他"
+    0xa66f,     // "她"
+    0xadd3,     // "個"
+    0xa457,     // "上"
+    0xa662,     // "在"
+    0xbba1,     // "說"
+    0xa65e,     // "回"
+};
+
+static const uint16_t freq_sjis[] = {
+    0x8140,     // "　"
+    0x8141,     // "、"
+    0x8142,     // "。"
+    0x8145,     // "・"
+    0x8146,     // "："
+    0x815b,     // "ー"
+    0x82b5,     // "し"
+    0x82bd,     // "た"
+    0x82c8,     // "な"
+    0x82c9,     // "に"
+    0x82cc,     // "の"
+    0x82dc,     // "ま"
+    0x82f0,     // "を"
+    0x8367,     // "ト"
+    0x8393,     // "ン"
+    0x89ef,     // "会"
+    0x906c,     // "人"
+    0x9094,     // "数"
+    0x93fa,     // "日"
+    0x95f1,     // "報"
+};
+
+static const uint16_t freq_euc_jp[] = {
+    0xa1bc,     // "ー"
+    0xa4bf,     // "た"
+    0xa4ca,     // "な"
+    0xa4cb,     // "に"
+    0xa4ce,     // "の"
+    0xa4de,     // "ま"
+    0xa4f2,     // "を"
+    0xa5c8,     // "ト"
+    0xa5f3,     // "ン"
+    0xb2f1,     // "会"
+    0xbfcd,     // "人"
+    0xbff4,     // "数"
+    0xc6fc,     // "日"
+    0xcaf3,     // "報"
+};
+
+static const uint16_t freq_euc_kr[] = {
+    0xc0cc,     // "이"
+    0xb0fa,     // "과"
+    0xb1e2,     // "기"
+    0xb4c2,     // "는"
+    0xb7ce,     // "로"
+    0xb1db,     // "글"
+    0xc5e4,     // "토"
+    0xc1a4,     // "정"
+};
+
+static const uint16_t freq_koi8_r[] = {
+    0xc920,     // "и "
+    0xc7cf,     // "го"
+    0xcbcf,     // "ко"
+    0xd3cb,     // "ск"
+    0xd3d4,     // "ст"
+};
+
+static const uint16_t freq_koi8_u[] = {
+    0xa6a7,     // "ії"
+    0xa6ce,     // "ін"
+    0xa6d7,     // "ів"
+    0xa7ce,     // "їн"
+    0xd0cf,     // "по"
+    0xd4c9,     // "ти"
+};
+
+// The tables above in the order they are searched
+#define TELLENC_FREQ_TABLES(X)                           \
+    X(TELLENC_WINDOWS_1250, freq_windows_1250)           \
+    X(TELLENC_WINDOWS_1252, freq_windows_1252)           \
+    X(TELLENC_CP437, freq_cp437)                         \
+    X(TELLENC_GBK, freq_gbk)                             \
+    X(TELLENC_BIG5, freq_big5)                           \
+    X(TELLENC_SJIS, freq_sjis)                           \
+    X(TELLENC_EUC_JP, freq_euc_jp)                       \
+    X(TELLENC_EUC_KR, freq_euc_kr)                       \
+    X(TELLENC_KOI8_R, freq_koi8_r)                       \
+    X(TELLENC_KOI8_U, freq_koi8_u)
+
+// Weights of the bytes 0x80-0xFF in single-byte encodings, by the
+// frequencies of the letters they stand for (lowercase ones weigh more);
+// bytes not used in text weigh -9.  The frequent letter pairs follow.
+
+static const signed char sbyte_weights_windows_1251[] = {
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 80-8F
+      0,  0,  0,  0,  0,  0,  0,  0, -9,  0,  0,  0,  0,  0,  0,  0,  // 90-9F
+      0,  0,  0,  0,  0,  1,  0,  0,  1,  0,  1,  0,  0,  0,  0,  1,  // A0-AF
+      0,  0,  3, 12,  1,  0,  0,  0,  1,  0,  2,  0,  0,  0,  0,  2,  // B0-BF
+      8,  1,  4,  1,  3,  8,  1,  1,  7,  1,  3,  4,  3,  6, 11,  2,  // C0-CF
+      4,  5,  6,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  2,  // D0-DF
+     32,  6, 18,  7, 12, 34,  4,  7, 29,  5, 14, 18, 13, 27, 44, 11,  // E0-EF
+     19, 22, 25, 10,  1,  4,  2,  6,  3,  1,  1,  8,  7,  1,  3,  8,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_windows_1251[] = {
+    0xf1f2, 0xedee, 0xf2ee, 0xede0, 0xe5ed, 0xeee2, 0xede8, 0xf0e0, 0xe2ee,
+    0xeaee, 0xeff0, 0xf0ee, 0xefee, 0xf0e5, 0xeef1, 0xeae0, 0xeeed, 0xede5,
+    0xe5f0, 0xf2e0, 0xf2e8, 0xedb3, 0xb3ed, 0xf2fc,
+};
+
+static const signed char sbyte_weights_koi8_r[] = {
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 80-8F
+     -9, -9, -9,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 90-9F
+     -9, -9, -9,  1, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // A0-AF
+     -9, -9, -9,  1, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  0,  // B0-BF
+      3, 32,  6,  2, 12, 34,  1,  7,  4, 29,  5, 14, 18, 13, 27, 44,  // C0-CF
+     11,  8, 19, 22, 25, 10,  4, 18,  7,  8,  7,  3,  1,  1,  6,  1,  // D0-DF
+      1,  8,  1,  1,  3,  8,  1,  1,  1,  7,  1,  3,  4,  3,  6, 11,  // E0-EF
+      2,  2,  4,  5,  6,  2,  1,  4,  1,  2,  1,  1,  1,  1,  1,  1,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_koi8_r[] = {
+    0xd3d4, 0xcecf, 0xd4cf, 0xcec1, 0xc5ce, 0xcfd7, 0xcec9, 0xd2c1, 0xd7cf,
+    0xcbcf, 0xd0d2, 0xd2cf, 0xd0cf, 0xd2c5, 0xcfd3, 0xcbc1, 0xcfce, 0xcec5,
+    0xc5d2, 0xd4c1, 0xd4c9, 0xd4d8,
+};
+
+static const signed char sbyte_weights_koi8_u[] = {
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 80-8F
+     -9, -9, -9,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 90-9F
+     -9, -9, -9,  1,  2, -9, 12,  2, -9, -9, -9, -9, -9,  1, -9, -9,  // A0-AF
+     -9, -9, -9,  1,  1, -9,  3,  1, -9, -9, -9, -9, -9,  1, -9,  0,  // B0-BF
+      3, 32,  6,  2, 12, 34,  1,  7,  4, 29,  5, 14, 18, 13, 27, 44,  // C0-CF
+     11,  8, 19, 22, 25, 10,  4, 18,  7,  8,  7,  3,  1,  1,  6,  1,  // D0-DF
+      1,  8,  1,  1,  3,  8,  1,  1,  1,  7,  1,  3,  4,  3,  6, 11,  // E0-EF
+      2,  2,  4,  5,  6,  2,  1,  4,  1,  2,  1,  1,  1,  1,  1,  1,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_koi8_u[] = {
+    0xd3d4, 0xcecf, 0xd4cf, 0xcec1, 0xc5ce, 0xcfd7, 0xcec9, 0xd2c1, 0xd7cf,
+    0xcbcf, 0xd0d2, 0xd2cf, 0xd0cf, 0xd2c5, 0xcfd3, 0xcbc1, 0xcfce, 0xcec5,
+    0xc5d2, 0xd4c1, 0xd4c9, 0xcea6, 0xa6ce, 0xd4d8,
+};
+
+static const signed char sbyte_weights_cp866[] = {
+      8,  1,  4,  1,  3,  8,  1,  1,  7,  1,  3,  4,  3,  6, 11,  2,  // 80-8F
+      4,  5,  6,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  2,  // 90-9F
+     32,  6, 18,  7, 12, 34,  4,  7, 29,  5, 14, 18, 13, 27, 44, 11,  // A0-AF
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // B0-BF
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // C0-CF
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // D0-DF
+     19, 22, 25, 10,  1,  4,  2,  6,  3,  1,  1,  8,  7,  1,  3,  8,  // E0-EF
+      1,  1,  1,  2,  1,  2,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_cp866[] = {
+    0xe1e2, 0xadae, 0xe2ae, 0xada0, 0xa5ad, 0xaea2, 0xada8, 0xe0a0, 0xa2ae,
+    0xaaae, 0xafe0, 0xe0ae, 0xafae, 0xe0a5, 0xaee1, 0xaaa0, 0xaead, 0xada5,
+    0xa5e0, 0xe2a0, 0xe2a8, 0xe2ec,
+};
+
+static const signed char sbyte_weights_iso_8859_5[] = {
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 80-8F
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 90-9F
+      0,  1,  0,  0,  1,  0,  3,  1,  0,  0,  0,  0,  0,  0,  0,  0,  // A0-AF
+      8,  1,  4,  1,  3,  8,  1,  1,  7,  1,  3,  4,  3,  6, 11,  2,  // B0-BF
+      4,  5,  6,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  2,  // C0-CF
+     32,  6, 18,  7, 12, 34,  4,  7, 29,  5, 14, 18, 13, 27, 44, 11,  // D0-DF
+     19, 22, 25, 10,  1,  4,  2,  6,  3,  1,  1,  8,  7,  1,  3,  8,  // E0-EF
+      0,  1,  0,  0,  2,  0, 12,  2,  0,  0,  0,  0,  0,  0,  0,  0,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_iso_8859_5[] = {
+    0xe1e2, 0xddde, 0xe2de, 0xddd0, 0xd5dd, 0xded2, 0xddd8, 0xe0d0, 0xd2de,
+    0xdade, 0xdfe0, 0xe0de, 0xdfde, 0xe0d5, 0xdee1, 0xdad0, 0xdedd, 0xddd5,
+    0xd5e0, 0xe2d0, 0xe2d8, 0xddf6, 0xf6dd, 0xe2ec,
+};
+
+static const signed char sbyte_weights_mac_cyrillic[] = {
+      8,  1,  4,  1,  3,  8,  1,  1,  7,  1,  3,  4,  3,  6, 11,  2,  // 80-8F
+      4,  5,  6,  2,  1,  1,  1,  1,  1,  1,  1,  2,  1,  1,  1,  2,  // 90-9F
+      0,  0,  1,  0,  0,  0,  0,  3,  0,  0,  0,  0,  0,  0,  0,  0,  // A0-AF
+      0,  0,  0,  0, 12,  0,  1,  0,  1,  2,  1,  2,  0,  0,  0,  0,  // B0-BF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // C0-CF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  8,  // D0-DF
+     32,  6, 18,  7, 12, 34,  4,  7, 29,  5, 14, 18, 13, 27, 44, 11,  // E0-EF
+     19, 22, 25, 10,  1,  4,  2,  6,  3,  1,  1,  8,  7,  1,  3,  0,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_mac_cyrillic[] = {
+    0xf1f2, 0xedee, 0xf2ee, 0xede0, 0xe5ed, 0xeee2, 0xede8, 0xf0e0, 0xe2ee,
+    0xeaee, 0xeff0, 0xf0ee, 0xefee, 0xf0e5, 0xeef1, 0xeae0, 0xeeed, 0xede5,
+    0xe5f0, 0xf2e0, 0xf2e8, 0xedb4, 0xb4ed, 0xf2fc,
+};
+
+static const signed char sbyte_weights_windows_1253[] = {
+      0, -9,  0,  0,  0,  0,  0,  0, -9,  0, -9,  0, -9, -9, -9, -9,  // 80-8F
+     -9,  0,  0,  0,  0,  0,  0,  0, -9,  0, -9,  0, -9, -9, -9, -9,  // 90-9F
+      0,  0,  2,  0,  0,  0,  0,  0,  0,  0, -9,  0,  0,  0,  0,  0,  // A0-AF
+      0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  0,  1,  0,  1,  1,  // B0-BF
+      0, 10,  1,  1,  1,  7,  1,  4,  1,  7,  4,  2,  3,  6,  1,  8,  // C0-CF
+      3,  3, -9,  4,  7,  3,  1,  1,  1,  1,  1,  1,  8,  6,  5,  7,  // D0-DF
+      0, 43,  2,  7,  6, 29,  1, 18,  5, 31, 16, 11, 13, 26,  2, 35,  // E0-EF
+     15, 15, 11, 16, 31, 14,  3,  4,  1,  6,  1,  1,  7,  3,  2, -9,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_windows_1253[] = {
+    0xf4ef, 0xf4e7, 0xeff5, 0xe1e9, 0xe5e9, 0xe7f2, 0xede1, 0xedf4, 0xf0ef,
+    0xe9ea, 0xece5, 0xeae1, 0xefed, 0xe5f1, 0xe1f0, 0xe5f4, 0xf3e5, 0xf3f4,
+    0xe9e1, 0xe5f0,
+};
+
+static const signed char sbyte_weights_iso_8859_7[] = {
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 80-8F
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 90-9F
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, -9,  0,  // A0-AF
+      0,  0,  0,  0,  0,  0,  2,  0,  1,  1,  1,  0,  1,  0,  1,  1,  // B0-BF
+      0, 10,  1,  1,  1,  7,  1,  4,  1,  7,  4,  2,  3,  6,  1,  8,  // C0-CF
+      3,  3, -9,  4,  7,  3,  1,  1,  1,  1,  1,  1,  8,  6,  5,  7,  // D0-DF
+      0, 43,  2,  7,  6, 29,  1, 18,  5, 31, 16, 11, 13, 26,  2, 35,  // E0-EF
+     15, 15, 11, 16, 31, 14,  3,  4,  1,  6,  1,  1,  7,  3,  2, -9,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_iso_8859_7[] = {
+    0xf4ef, 0xf4e7, 0xeff5, 0xe1e9, 0xe5e9, 0xe7f2, 0xede1, 0xedf4, 0xf0ef,
+    0xe9ea, 0xece5, 0xeae1, 0xefed, 0xe5f1, 0xe1f0, 0xe5f4, 0xf3e5, 0xf3f4,
+    0xe9e1, 0xe5f0,
+};
+
+static const signed char sbyte_weights_windows_1255[] = {
+      0, -9,  0,  0,  0,  0,  0,  0,  0,  0, -9,  0, -9, -9, -9, -9,  // 80-8F
+     -9,  0,  0,  0,  0,  0,  0,  0,  0,  0, -9,  0, -9, -9, -9, -9,  // 90-9F
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // A0-AF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // B0-BF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0, -9,  0,  0,  0,  0,  0,  // C0-CF
+      0,  0,  0,  0,  0,  0,  0,  0,  0, -9, -9, -9, -9, -9, -9, -9,  // D0-DF
+     23, 18,  5,  9, 33, 39,  3,  9,  5, 42,  3,  9, 28, 11, 24,  5,  // E0-EF
+     14,  4, 11,  1,  6,  1,  3,  7, 21, 17, 20, -9, -9,  0,  0, -9,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_windows_1255[] = {
+    0xf9ec, 0xe0fa, 0xe9ed, 0xe5e4, 0xe5fa, 0xe4e5, 0xece4, 0xe9e4, 0xe0ec,
+    0xf2ec, 0xf0e9, 0xf8e9, 0xeee4, 0xe1e9, 0xece0, 0xe4e9, 0xebe9, 0xe0e9,
+    0xf9e4, 0xfae9,
+};
+
+static const signed char sbyte_weights_iso_8859_8[] = {
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 80-8F
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 90-9F
+      0, -9,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // A0-AF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, -9,  // B0-BF
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // C0-CF
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  0,  // D0-DF
+     23, 18,  5,  9, 33, 39,  3,  9,  5, 42,  3,  9, 28, 11, 24,  5,  // E0-EF
+     14,  4, 11,  1,  6,  1,  3,  7, 21, 17, 20, -9, -9,  0,  0, -9,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_iso_8859_8[] = {
+    0xf9ec, 0xe0fa, 0xe9ed, 0xe5e4, 0xe5fa, 0xe4e5, 0xece4, 0xe9e4, 0xe0ec,
+    0xf2ec, 0xf0e9, 0xf8e9, 0xeee4, 0xe1e9, 0xece0, 0xe4e9, 0xebe9, 0xe0e9,
+    0xf9e4, 0xfae9,
+};
+
+static const signed char sbyte_weights_windows_1256[] = {
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 80-8F
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 90-9F
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // A0-AF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // B0-BF
+      0,  2,  1, 11,  1,  4,  2, 53, 15, 13, 17,  2,  5,  8,  3, 13,  // C0-CF
+      3, 19,  2, 11,  4,  4,  2,  0,  3,  1, 13,  2,  0, 11,  9,  8,  // D0-DF
+      0, 46,  0, 23, 21, 17, 23,  0,  0,  0,  0,  0,  5, 27,  0,  0,  // E0-EF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_windows_1256[] = {
+    0xc7e1, 0xe1c7, 0xdded, 0xe3e4, 0xc7e4, 0xe1e3, 0xe3c7, 0xedc9, 0xede4,
+    0xe5c7, 0xc7d1, 0xe1ca, 0xe6e4, 0xc7ca, 0xe6c7, 0xe4c7, 0xe1ed, 0xd1ed,
+    0xdae1, 0xe1ec,
+};
+
+static const signed char sbyte_weights_tis_620[] = {
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 80-8F
+     -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9, -9,  // 90-9F
+     -9, 26,  9,  0, 12,  0,  0, 21,  8,  1,  6,  2,  0,  1,  0,  0,  // A0-AF
+      1,  0,  0,  3, 14, 13,  3, 14,  2, 33,  9,  9,  3,  1,  8,  1,  // B0-BF
+      2, 19, 16, 30,  0, 12,  0, 16,  2,  1, 12, 12,  0, 26,  0,  0,  // C0-CF
+      9, 16, 40,  7, 14, 14,  4,  5,  7,  5,  0, -9, -9, -9, -9,  0,  // D0-DF
+     23,  9,  5,  6,  7,  0,  1,  6, 28, 16,  0,  0,  5,  0,  0,  0,  // E0-EF
+      0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, -9, -9, -9, -9,  // F0-FF
+};
+
+static const uint16_t sbyte_bigrams_tis_620[] = {
+    0xd2c3, 0xcda7, 0xb7d5, 0xd5e8, 0xc3d0, 0xa1d2, 0xb9a1, 0xd2b9, 0xe3cb,
+    0xe4c1, 0xe4b4, 0xe0bb, 0xe7b9, 0xd1e9, 0xe8d2, 0xc1d5, 0xa4c7, 0xc7d2,
+    0xc5d0, 0xa2cd,
+};
+
+// The single-byte models above, tried in this order; a later one wins
+// only with a higher score, so Windows code pages go before ISO ones
+#define TELLENC_SBYTE_MODELS(X)                                 \
+    X(TELLENC_WINDOWS_1251, windows_1251)                       \
+    X(TELLENC_KOI8_R, koi8_r)                                   \
+    X(TELLENC_KOI8_U, koi8_u)                                   \
+    X(TELLENC_CP866, cp866)                                     \
+    X(TELLENC_ISO_8859_5, iso_8859_5)                           \
+    X(TELLENC_MAC_CYRILLIC, mac_cyrillic)                       \
+    X(TELLENC_WINDOWS_1253, windows_1253)                       \
+    X(TELLENC_ISO_8859_7, iso_8859_7)                           \
+    X(TELLENC_WINDOWS_1255, windows_1255)                       \
+    X(TELLENC_ISO_8859_8, iso_8859_8)                           \
+    X(TELLENC_WINDOWS_1256, windows_1256)                       \
+    X(TELLENC_TIS_620, tis_620)
+
+// Characters of the bytes 0x80-0xFF in single-byte encodings, for the
+// language; 0 if undefined.  Latin1 and Windows-1252 need no tables.
+
+static const uint16_t sbyte_chars_windows_1250[] = {
+    0x20ac, 0x0000, 0x201a, 0x0000, 0x201e, 0x2026, 0x2020, 0x2021,  // 80-87
+    0x0000, 0x2030, 0x0160, 0x2039, 0x015a, 0x0164, 0x017d, 0x0179,  // 88-8F
+    0x0000, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,  // 90-97
+    0x0000, 0x2122, 0x0161, 0x203a, 0x015b, 0x0165, 0x017e, 0x017a,  // 98-9F
+    0x00a0, 0x02c7, 0x02d8, 0x0141, 0x00a4, 0x0104, 0x00a6, 0x00a7,  // A0-A7
+    0x00a8, 0x00a9, 0x015e, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x017b,  // A8-AF
+    0x00b0, 0x00b1, 0x02db, 0x0142, 0x00b4, 0x00b5, 0x00b6, 0x00b7,  // B0-B7
+    0x00b8, 0x0105, 0x015f, 0x00bb, 0x013d, 0x02dd, 0x013e, 0x017c,  // B8-BF
+    0x0154, 0x00c1, 0x00c2, 0x0102, 0x00c4, 0x0139, 0x0106, 0x00c7,  // C0-C7
+    0x010c, 0x00c9, 0x0118, 0x00cb, 0x011a, 0x00cd, 0x00ce, 0x010e,  // C8-CF
+    0x0110, 0x0143, 0x0147, 0x00d3, 0x00d4, 0x0150, 0x00d6, 0x00d7,  // D0-D7
+    0x0158, 0x016e, 0x00da, 0x0170, 0x00dc, 0x00dd, 0x0162, 0x00df,  // D8-DF
+    0x0155, 0x00e1, 0x00e2, 0x0103, 0x00e4, 0x013a, 0x0107, 0x00e7,  // E0-E7
+    0x010d, 0x00e9, 0x0119, 0x00eb, 0x011b, 0x00ed, 0x00ee, 0x010f,  // E8-EF
+    0x0111, 0x0144, 0x0148, 0x00f3, 0x00f4, 0x0151, 0x00f6, 0x00f7,  // F0-F7
+    0x0159, 0x016f, 0x00fa, 0x0171, 0x00fc, 0x00fd, 0x0163, 0x02d9,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_cp437[] = {
+    0x00c7, 0x00fc, 0x00e9, 0x00e2, 0x00e4, 0x00e0, 0x00e5, 0x00e7,  // 80-87
+    0x00ea, 0x00eb, 0x00e8, 0x00ef, 0x00ee, 0x00ec, 0x00c4, 0x00c5,  // 88-8F
+    0x00c9, 0x00e6, 0x00c6, 0x00f4, 0x00f6, 0x00f2, 0x00fb, 0x00f9,  // 90-97
+    0x00ff, 0x00d6, 0x00dc, 0x00a2, 0x00a3, 0x00a5, 0x20a7, 0x0192,  // 98-9F
+    0x00e1, 0x00ed, 0x00f3, 0x00fa, 0x00f1, 0x00d1, 0x00aa, 0x00ba,  // A0-A7
+    0x00bf, 0x2310, 0x00ac, 0x00bd, 0x00bc, 0x00a1, 0x00ab, 0x00bb,  // A8-AF
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,  // B0-B7
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255d, 0x255c, 0x255b, 0x2510,  // B8-BF
+    0x2514, 0x2534, 0x252c, 0x251c, 0x2500, 0x253c, 0x255e, 0x255f,  // C0-C7
+    0x255a, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256c, 0x2567,  // C8-CF
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256b,  // D0-D7
+    0x256a, 0x2518, 0x250c, 0x2588, 0x2584, 0x258c, 0x2590, 0x2580,  // D8-DF
+    0x03b1, 0x00df, 0x0393, 0x03c0, 0x03a3, 0x03c3, 0x00b5, 0x03c4,  // E0-E7
+    0x03a6, 0x0398, 0x03a9, 0x03b4, 0x221e, 0x03c6, 0x03b5, 0x2229,  // E8-EF
+    0x2261, 0x00b1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00f7, 0x2248,  // F0-F7
+    0x00b0, 0x2219, 0x00b7, 0x221a, 0x207f, 0x00b2, 0x25a0, 0x00a0,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_koi8_r[] = {
+    0x2500, 0x2502, 0x250c, 0x2510, 0x2514, 0x2518, 0x251c, 0x2524,  // 80-87
+    0x252c, 0x2534, 0x253c, 0x2580, 0x2584, 0x2588, 0x258c, 0x2590,  // 88-8F
+    0x2591, 0x2592, 0x2593, 0x2320, 0x25a0, 0x2219, 0x221a, 0x2248,  // 90-97
+    0x2264, 0x2265, 0x00a0, 0x2321, 0x00b0, 0x00b2, 0x00b7, 0x00f7,  // 98-9F
+    0x2550, 0x2551, 0x2552, 0x0451, 0x2553, 0x2554, 0x2555, 0x2556,  // A0-A7
+    0x2557, 0x2558, 0x2559, 0x255a, 0x255b, 0x255c, 0x255d, 0x255e,  // A8-AF
+    0x255f, 0x2560, 0x2561, 0x0401, 0x2562, 0x2563, 0x2564, 0x2565,  // B0-B7
+    0x2566, 0x2567, 0x2568, 0x2569, 0x256a, 0x256b, 0x256c, 0x00a9,  // B8-BF
+    0x044e, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433,  // C0-C7
+    0x0445, 0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e,  // C8-CF
+    0x043f, 0x044f, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432,  // D0-D7
+    0x044c, 0x044b, 0x0437, 0x0448, 0x044d, 0x0449, 0x0447, 0x044a,  // D8-DF
+    0x042e, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413,  // E0-E7
+    0x0425, 0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e,  // E8-EF
+    0x041f, 0x042f, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412,  // F0-F7
+    0x042c, 0x042b, 0x0417, 0x0428, 0x042d, 0x0429, 0x0427, 0x042a,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_koi8_u[] = {
+    0x2500, 0x2502, 0x250c, 0x2510, 0x2514, 0x2518, 0x251c, 0x2524,  // 80-87
+    0x252c, 0x2534, 0x253c, 0x2580, 0x2584, 0x2588, 0x258c, 0x2590,  // 88-8F
+    0x2591, 0x2592, 0x2593, 0x2320, 0x25a0, 0x2219, 0x221a, 0x2248,  // 90-97
+    0x2264, 0x2265, 0x00a0, 0x2321, 0x00b0, 0x00b2, 0x00b7, 0x00f7,  // 98-9F
+    0x2550, 0x2551, 0x2552, 0x0451, 0x0454, 0x2554, 0x0456, 0x0457,  // A0-A7
+    0x2557, 0x2558, 0x2559, 0x255a, 0x255b, 0x0491, 0x255d, 0x255e,  // A8-AF
+    0x255f, 0x2560, 0x2561, 0x0401, 0x0404, 0x2563, 0x0406, 0x0407,  // B0-B7
+    0x2566, 0x2567, 0x2568, 0x2569, 0x256a, 0x0490, 0x256c, 0x00a9,  // B8-BF
+    0x044e, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433,  // C0-C7
+    0x0445, 0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e,  // C8-CF
+    0x043f, 0x044f, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432,  // D0-D7
+    0x044c, 0x044b, 0x0437, 0x0448, 0x044d, 0x0449, 0x0447, 0x044a,  // D8-DF
+    0x042e, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413,  // E0-E7
+    0x0425, 0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e,  // E8-EF
+    0x041f, 0x042f, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412,  // F0-F7
+    0x042c, 0x042b, 0x0417, 0x0428, 0x042d, 0x0429, 0x0427, 0x042a,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_windows_1251[] = {
+    0x0402, 0x0403, 0x201a, 0x0453, 0x201e, 0x2026, 0x2020, 0x2021,  // 80-87
+    0x20ac, 0x2030, 0x0409, 0x2039, 0x040a, 0x040c, 0x040b, 0x040f,  // 88-8F
+    0x0452, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,  // 90-97
+    0x0000, 0x2122, 0x0459, 0x203a, 0x045a, 0x045c, 0x045b, 0x045f,  // 98-9F
+    0x00a0, 0x040e, 0x045e, 0x0408, 0x00a4, 0x0490, 0x00a6, 0x00a7,  // A0-A7
+    0x0401, 0x00a9, 0x0404, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x0407,  // A8-AF
+    0x00b0, 0x00b1, 0x0406, 0x0456, 0x0491, 0x00b5, 0x00b6, 0x00b7,  // B0-B7
+    0x0451, 0x2116, 0x0454, 0x00bb, 0x0458, 0x0405, 0x0455, 0x0457,  // B8-BF
+    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,  // C0-C7
+    0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,  // C8-CF
+    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,  // D0-D7
+    0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,  // D8-DF
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,  // E0-E7
+    0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,  // E8-EF
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,  // F0-F7
+    0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_cp866[] = {
+    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,  // 80-87
+    0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,  // 88-8F
+    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,  // 90-97
+    0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,  // 98-9F
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,  // A0-A7
+    0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,  // A8-AF
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,  // B0-B7
+    0x2555, 0x2563, 0x2551, 0x2557, 0x255d, 0x255c, 0x255b, 0x2510,  // B8-BF
+    0x2514, 0x2534, 0x252c, 0x251c, 0x2500, 0x253c, 0x255e, 0x255f,  // C0-C7
+    0x255a, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256c, 0x2567,  // C8-CF
+    0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256b,  // D0-D7
+    0x256a, 0x2518, 0x250c, 0x2588, 0x2584, 0x258c, 0x2590, 0x2580,  // D8-DF
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,  // E0-E7
+    0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,  // E8-EF
+    0x0401, 0x0451, 0x0404, 0x0454, 0x0407, 0x0457, 0x040e, 0x045e,  // F0-F7
+    0x00b0, 0x2219, 0x00b7, 0x221a, 0x2116, 0x00a4, 0x25a0, 0x00a0,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_iso_8859_5[] = {
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,  // 80-87
+    0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,  // 88-8F
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,  // 90-97
+    0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,  // 98-9F
+    0x00a0, 0x0401, 0x0402, 0x0403, 0x0404, 0x0405, 0x0406, 0x0407,  // A0-A7
+    0x0408, 0x0409, 0x040a, 0x040b, 0x040c, 0x00ad, 0x040e, 0x040f,  // A8-AF
+    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,  // B0-B7
+    0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,  // B8-BF
+    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,  // C0-C7
+    0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,  // C8-CF
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,  // D0-D7
+    0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,  // D8-DF
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,  // E0-E7
+    0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,  // E8-EF
+    0x2116, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457,  // F0-F7
+    0x0458, 0x0459, 0x045a, 0x045b, 0x045c, 0x00a7, 0x045e, 0x045f,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_mac_cyrillic[] = {
+    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,  // 80-87
+    0x0418, 0x0419, 0x041a, 0x041b, 0x041c, 0x041d, 0x041e, 0x041f,  // 88-8F
+    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,  // 90-97
+    0x0428, 0x0429, 0x042a, 0x042b, 0x042c, 0x042d, 0x042e, 0x042f,  // 98-9F
+    0x2020, 0x00b0, 0x0490, 0x00a3, 0x00a7, 0x2022, 0x00b6, 0x0406,  // A0-A7
+    0x00ae, 0x00a9, 0x2122, 0x0402, 0x0452, 0x2260, 0x0403, 0x0453,  // A8-AF
+    0x221e, 0x00b1, 0x2264, 0x2265, 0x0456, 0x00b5, 0x0491, 0x0408,  // B0-B7
+    0x0404, 0x0454, 0x0407, 0x0457, 0x0409, 0x0459, 0x040a, 0x045a,  // B8-BF
+    0x0458, 0x0405, 0x00ac, 0x221a, 0x0192, 0x2248, 0x2206, 0x00ab,  // C0-C7
+    0x00bb, 0x2026, 0x00a0, 0x040b, 0x045b, 0x040c, 0x045c, 0x0455,  // C8-CF
+    0x2013, 0x2014, 0x201c, 0x201d, 0x2018, 0x2019, 0x00f7, 0x201e,  // D0-D7
+    0x040e, 0x045e, 0x040f, 0x045f, 0x2116, 0x0401, 0x0451, 0x044f,  // D8-DF
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,  // E0-E7
+    0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,  // E8-EF
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,  // F0-F7
+    0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x20ac,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_windows_1253[] = {
+    0x20ac, 0x0000, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,  // 80-87
+    0x0000, 0x2030, 0x0000, 0x2039, 0x0000, 0x0000, 0x0000, 0x0000,  // 88-8F
+    0x0000, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,  // 90-97
+    0x0000, 0x2122, 0x0000, 0x203a, 0x0000, 0x0000, 0x0000, 0x0000,  // 98-9F
+    0x00a0, 0x0385, 0x0386, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,  // A0-A7
+    0x00a8, 0x00a9, 0x0000, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x2015,  // A8-AF
+    0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x0384, 0x00b5, 0x00b6, 0x00b7,  // B0-B7
+    0x0388, 0x0389, 0x038a, 0x00bb, 0x038c, 0x00bd, 0x038e, 0x038f,  // B8-BF
+    0x0390, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397,  // C0-C7
+    0x0398, 0x0399, 0x039a, 0x039b, 0x039c, 0x039d, 0x039e, 0x039f,  // C8-CF
+    0x03a0, 0x03a1, 0x0000, 0x03a3, 0x03a4, 0x03a5, 0x03a6, 0x03a7,  // D0-D7
+    0x03a8, 0x03a9, 0x03aa, 0x03ab, 0x03ac, 0x03ad, 0x03ae, 0x03af,  // D8-DF
+    0x03b0, 0x03b1, 0x03b2, 0x03b3, 0x03b4, 0x03b5, 0x03b6, 0x03b7,  // E0-E7
+    0x03b8, 0x03b9, 0x03ba, 0x03bb, 0x03bc, 0x03bd, 0x03be, 0x03bf,  // E8-EF
+    0x03c0, 0x03c1, 0x03c2, 0x03c3, 0x03c4, 0x03c5, 0x03c6, 0x03c7,  // F0-F7
+    0x03c8, 0x03c9, 0x03ca, 0x03cb, 0x03cc, 0x03cd, 0x03ce, 0x0000,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_iso_8859_7[] = {
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,  // 80-87
+    0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,  // 88-8F
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,  // 90-97
+    0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,  // 98-9F
+    0x00a0, 0x2018, 0x2019, 0x00a3, 0x20ac, 0x20af, 0x00a6, 0x00a7,  // A0-A7
+    0x00a8, 0x00a9, 0x037a, 0x00ab, 0x00ac, 0x00ad, 0x0000, 0x2015,  // A8-AF
+    0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x0384, 0x0385, 0x0386, 0x00b7,  // B0-B7
+    0x0388, 0x0389, 0x038a, 0x00bb, 0x038c, 0x00bd, 0x038e, 0x038f,  // B8-BF
+    0x0390, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397,  // C0-C7
+    0x0398, 0x0399, 0x039a, 0x039b, 0x039c, 0x039d, 0x039e, 0x039f,  // C8-CF
+    0x03a0, 0x03a1, 0x0000, 0x03a3, 0x03a4, 0x03a5, 0x03a6, 0x03a7,  // D0-D7
+    0x03a8, 0x03a9, 0x03aa, 0x03ab, 0x03ac, 0x03ad, 0x03ae, 0x03af,  // D8-DF
+    0x03b0, 0x03b1, 0x03b2, 0x03b3, 0x03b4, 0x03b5, 0x03b6, 0x03b7,  // E0-E7
+    0x03b8, 0x03b9, 0x03ba, 0x03bb, 0x03bc, 0x03bd, 0x03be, 0x03bf,  // E8-EF
+    0x03c0, 0x03c1, 0x03c2, 0x03c3, 0x03c4, 0x03c5, 0x03c6, 0x03c7,  // F0-F7
+    0x03c8, 0x03c9, 0x03ca, 0x03cb, 0x03cc, 0x03cd, 0x03ce, 0x0000,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_windows_1255[] = {
+    0x20ac, 0x0000, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,  // 80-87
+    0x02c6, 0x2030, 0x0000, 0x2039, 0x0000, 0x0000, 0x0000, 0x0000,  // 88-8F
+    0x0000, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,  // 90-97
+    0x02dc, 0x2122, 0x0000, 0x203a, 0x0000, 0x0000, 0x0000, 0x0000,  // 98-9F
+    0x00a0, 0x00a1, 0x00a2, 0x00a3, 0x20aa, 0x00a5, 0x00a6, 0x00a7,  // A0-A7
+    0x00a8, 0x00a9, 0x00d7, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,  // A8-AF
+    0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,  // B0-B7
+    0x00b8, 0x00b9, 0x00f7, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x00bf,  // B8-BF
+    0x05b0, 0x05b1, 0x05b2, 0x05b3, 0x05b4, 0x05b5, 0x05b6, 0x05b7,  // C0-C7
+    0x05b8, 0x05b9, 0x0000, 0x05bb, 0x05bc, 0x05bd, 0x05be, 0x05bf,  // C8-CF
+    0x05c0, 0x05c1, 0x05c2, 0x05c3, 0x05f0, 0x05f1, 0x05f2, 0x05f3,  // D0-D7
+    0x05f4, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // D8-DF
+    0x05d0, 0x05d1, 0x05d2, 0x05d3, 0x05d4, 0x05d5, 0x05d6, 0x05d7,  // E0-E7
+    0x05d8, 0x05d9, 0x05da, 0x05db, 0x05dc, 0x05dd, 0x05de, 0x05df,  // E8-EF
+    0x05e0, 0x05e1, 0x05e2, 0x05e3, 0x05e4, 0x05e5, 0x05e6, 0x05e7,  // F0-F7
+    0x05e8, 0x05e9, 0x05ea, 0x0000, 0x0000, 0x200e, 0x200f, 0x0000,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_iso_8859_8[] = {
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,  // 80-87
+    0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,  // 88-8F
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,  // 90-97
+    0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,  // 98-9F
+    0x00a0, 0x0000, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,  // A0-A7
+    0x00a8, 0x00a9, 0x00d7, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,  // A8-AF
+    0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,  // B0-B7
+    0x00b8, 0x00b9, 0x00f7, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x0000,  // B8-BF
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // C0-C7
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // C8-CF
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,  // D0-D7
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x2017,  // D8-DF
+    0x05d0, 0x05d1, 0x05d2, 0x05d3, 0x05d4, 0x05d5, 0x05d6, 0x05d7,  // E0-E7
+    0x05d8, 0x05d9, 0x05da, 0x05db, 0x05dc, 0x05dd, 0x05de, 0x05df,  // E8-EF
+    0x05e0, 0x05e1, 0x05e2, 0x05e3, 0x05e4, 0x05e5, 0x05e6, 0x05e7,  // F0-F7
+    0x05e8, 0x05e9, 0x05ea, 0x0000, 0x0000, 0x200e, 0x200f, 0x0000,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_windows_1256[] = {
+    0x20ac, 0x067e, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,  // 80-87
+    0x02c6, 0x2030, 0x0679, 0x2039, 0x0152, 0x0686, 0x0698, 0x0688,  // 88-8F
+    0x06af, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,  // 90-97
+    0x06a9, 0x2122, 0x0691, 0x203a, 0x0153, 0x200c, 0x200d, 0x06ba,  // 98-9F
+    0x00a0, 0x060c, 0x00a2, 0x00a3, 0x00a4, 0x00a5, 0x00a6, 0x00a7,  // A0-A7
+    0x00a8, 0x00a9, 0x06be, 0x00ab, 0x00ac, 0x00ad, 0x00ae, 0x00af,  // A8-AF
+    0x00b0, 0x00b1, 0x00b2, 0x00b3, 0x00b4, 0x00b5, 0x00b6, 0x00b7,  // B0-B7
+    0x00b8, 0x00b9, 0x061b, 0x00bb, 0x00bc, 0x00bd, 0x00be, 0x061f,  // B8-BF
+    0x06c1, 0x0621, 0x0622, 0x0623, 0x0624, 0x0625, 0x0626, 0x0627,  // C0-C7
+    0x0628, 0x0629, 0x062a, 0x062b, 0x062c, 0x062d, 0x062e, 0x062f,  // C8-CF
+    0x0630, 0x0631, 0x0632, 0x0633, 0x0634, 0x0635, 0x0636, 0x00d7,  // D0-D7
+    0x0637, 0x0638, 0x0639, 0x063a, 0x0640, 0x0641, 0x0642, 0x0643,  // D8-DF
+    0x00e0, 0x0644, 0x00e2, 0x0645, 0x0646, 0x0647, 0x0648, 0x00e7,  // E0-E7
+    0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x0649, 0x064a, 0x00ee, 0x00ef,  // E8-EF
+    0x064b, 0x064c, 0x064d, 0x064e, 0x00f4, 0x064f, 0x0650, 0x00f7,  // F0-F7
+    0x0651, 0x00f9, 0x0652, 0x00fb, 0x00fc, 0x200e, 0x200f, 0x06d2,  // F8-FF
+};
+
+static const uint16_t sbyte_chars_tis_620[] = {
+    0x0080, 0x0081, 0x0082, 0x0083, 0x0084, 0x0085, 0x0086, 0x0087,  // 80-87
+    0x0088, 0x0089, 0x008a, 0x008b, 0x008c, 0x008d, 0x008e, 0x008f,  // 88-8F
+    0x0090, 0x0091, 0x0092, 0x0093, 0x0094, 0x0095, 0x0096, 0x0097,  // 90-97
+    0x0098, 0x0099, 0x009a, 0x009b, 0x009c, 0x009d, 0x009e, 0x009f,  // 98-9F
+    0x0000, 0x0e01, 0x0e02, 0x0e03, 0x0e04, 0x0e05, 0x0e06, 0x0e07,  // A0-A7
+    0x0e08, 0x0e09, 0x0e0a, 0x0e0b, 0x0e0c, 0x0e0d, 0x0e0e, 0x0e0f,  // A8-AF
+    0x0e10, 0x0e11, 0x0e12, 0x0e13, 0x0e14, 0x0e15, 0x0e16, 0x0e17,  // B0-B7
+    0x0e18, 0x0e19, 0x0e1a, 0x0e1b, 0x0e1c, 0x0e1d, 0x0e1e, 0x0e1f,  // B8-BF
+    0x0e20, 0x0e21, 0x0e22, 0x0e23, 0x0e24, 0x0e25, 0x0e26, 0x0e27,  // C0-C7
+    0x0e28, 0x0e29, 0x0e2a, 0x0e2b, 0x0e2c, 0x0e2d, 0x0e2e, 0x0e2f,  // C8-CF
+    0x0e30, 0x0e31, 0x0e32, 0x0e33, 0x0e34, 0x0e35, 0x0e36, 0x0e37,  // D0-D7
+    0x0e38, 0x0e39, 0x0e3a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0e3f,  // D8-DF
+    0x0e40, 0x0e41, 0x0e42, 0x0e43, 0x0e44, 0x0e45, 0x0e46, 0x0e47,  // E0-E7
+    0x0e48, 0x0e49, 0x0e4a, 0x0e4b, 0x0e4c, 0x0e4d, 0x0e4e, 0x0e4f,  // E8-EF
+    0x0e50, 0x0e51, 0x0e52, 0x0e53, 0x0e54, 0x0e55, 0x0e56, 0x0e57,  // F0-F7
+    0x0e58, 0x0e59, 0x0e5a, 0x0e5b, 0x0000, 0x0000, 0x0000, 0x0000,  // F8-FF
+};
+
+#define TELLENC_SBYTE_CHARSETS(X)                               \
+    X(TELLENC_WINDOWS_1250, windows_1250)                       \
+    X(TELLENC_CP437, cp437)                                     \
+    X(TELLENC_KOI8_R, koi8_r)                                   \
+    X(TELLENC_KOI8_U, koi8_u)                                   \
+    X(TELLENC_WINDOWS_1251, windows_1251)                       \
+    X(TELLENC_CP866, cp866)                                     \
+    X(TELLENC_ISO_8859_5, iso_8859_5)                           \
+    X(TELLENC_MAC_CYRILLIC, mac_cyrillic)                       \
+    X(TELLENC_WINDOWS_1253, windows_1253)                       \
+    X(TELLENC_ISO_8859_7, iso_8859_7)                           \
+    X(TELLENC_WINDOWS_1255, windows_1255)                       \
+    X(TELLENC_ISO_8859_8, iso_8859_8)                           \
+    X(TELLENC_WINDOWS_1256, windows_1256)                       \
+    X(TELLENC_TIS_620, tis_620)
+
+/**
+ * Letters of a language: the code points \a first to \a last (ASCII
+ * letters for 'a' to 'z'), and how many of 10000 letters of the language
+ * are among them.  The first row of a language is its main letters,
+ * which take the rest of the 10000, less the letters of the other rows
+ * that fall in its range.  Ranges from 0x800 are whole blocks of 64.
+ */
+struct language_letters {
+    unsigned char   language;
+    uint16_t        first;
+    uint16_t        last;
+    uint16_t        per_10000;
+};
+
+static const language_letters language_models[] = {
+    { TELLENC_LANG_EN, 'a', 'z', 0 },
+
+    { TELLENC_LANG_FR, 'a', 'z', 0 },
+    { TELLENC_LANG_FR, 0xe9, 0xe9, 150 },       // e acute
+    { TELLENC_LANG_FR, 0xe8, 0xe8, 27 },        // e grave
+    { TELLENC_LANG_FR, 0xea, 0xea, 22 },        // e circumflex
+    { TELLENC_LANG_FR, 0xe0, 0xe0, 49 },        // a grave
+    { TELLENC_LANG_FR, 0xe2, 0xe2, 5 },         // a circumflex
+    { TELLENC_LANG_FR, 0xe7, 0xe7, 9 },         // c cedilla
+    { TELLENC_LANG_FR, 0xee, 0xee, 5 },         // i circumflex
+    { TELLENC_LANG_FR, 0xf4, 0xf4, 2 },         // o circumflex
+    { TELLENC_LANG_FR, 0xfb, 0xfb, 6 },         // u circumflex
+    { TELLENC_LANG_FR, 0xf9, 0xf9, 6 },         // u grave
+    { TELLENC_LANG_FR, 0xeb, 0xeb, 1 },         // e diaeresis
+    { TELLENC_LANG_FR, 0xef, 0xef, 1 },         // i diaeresis
+    { TELLENC_LANG_FR, 0x153, 0x153, 2 },       // oe
+
+    { TELLENC_LANG_DE, 'a', 'z', 0 },
+    { TELLENC_LANG_DE, 0xe4, 0xe4, 58 },        // a diaeresis
+    { TELLENC_LANG_DE, 0xf6, 0xf6, 44 },        // o diaeresis
+    { TELLENC_LANG_DE, 0xfc, 0xfc, 100 },       // u diaeresis
+    { TELLENC_LANG_DE, 0xdf, 0xdf, 31 },        // sharp s
+
+    { TELLENC_LANG_ES, 'a', 'z', 0 },
+    { TELLENC_LANG_ES, 0xe1, 0xe1, 50 },        // a acute
+    { TELLENC_LANG_ES, 0xe9, 0xe9, 43 },        // e acute
+    { TELLENC_LANG_ES, 0xed, 0xed, 73 },        // i acute
+    { TELLENC_LANG_ES, 0xf3, 0xf3, 83 },        // o acute
+    { TELLENC_LANG_ES, 0xfa, 0xfa, 17 },        // u acute
+    { TELLENC_LANG_ES, 0xf1, 0xf1, 31 },        // n tilde
+    { TELLENC_LANG_ES, 0xfc, 0xfc, 1 },         // u diaeresis
+
+    { TELLENC_LANG_FI, 'a', 'z', 0 },
+    { TELLENC_LANG_FI, 0xe4, 0xe4, 358 },       // a diaeresis
+    { TELLENC_LANG_FI, 0xf6, 0xf6, 44 },        // o diaeresis
+    { TELLENC_LANG_FI, 0xe5, 0xe5, 1 },         // a ring
+
+    { TELLENC_LANG_CS, 'a', 'z', 0 },
+    { TELLENC_LANG_CS, 0xe1, 0xe1, 87 },        // a acute
+    { TELLENC_LANG_CS, 0x10d, 0x10d, 46 },      // c caron
+    { TELLENC_LANG_CS, 0x10f, 0x10f, 2 },       // d caron
+    { TELLENC_LANG_CS, 0xe9, 0xe9, 63 },        // e acute
+    { TELLENC_LANG_CS, 0x11b, 0x11b, 122 },     // e caron
+    { TELLENC_LANG_CS, 0xed, 0xed, 164 },       // i acute
+    { TELLENC_LANG_CS, 0x148, 0x148, 7 },       // n caron
+    { TELLENC_LANG_CS, 0xf3, 0xf3, 2 },         // o acute
+    { TELLENC_LANG_CS, 0x159, 0x159, 38 },      // r caron
+    { TELLENC_LANG_CS, 0x161, 0x161, 69 },      // s caron
+    { TELLENC_LANG_CS, 0x165, 0x165, 4 },       // t caron
+    { TELLENC_LANG_CS, 0xfa, 0xfa, 5 },         // u acute
+    { TELLENC_LANG_CS, 0x16f, 0x16f, 20 },      // u ring
+    { TELLENC_LANG_CS, 0xfd, 0xfd, 100 },       // y acute
+    { TELLENC_LANG_CS, 0x17e, 0x17e, 72 },      // z caron
+
+    { TELLENC_LANG_SK, 'a', 'z', 0 },
+    { TELLENC_LANG_SK, 0xe1, 0xe1, 170 },       // a acute
+    { TELLENC_LANG_SK, 0xe4, 0xe4, 10 },        // a diaeresis
+    { TELLENC_LANG_SK, 0x10d, 0x10d, 95 },      // c caron
+    { TELLENC_LANG_SK, 0x10f, 0x10f, 15 },      // d caron
+    { TELLENC_LANG_SK, 0xe9, 0xe9, 70 },        // e acute
+    { TELLENC_LANG_SK, 0xed, 0xed, 140 },       // i acute
+    { TELLENC_LANG_SK, 0x13a, 0x13a, 2 },       // l acute
+    { TELLENC_LANG_SK, 0x13e, 0x13e, 40 },      // l caron
+    { TELLENC_LANG_SK, 0x148, 0x148, 15 },      // n caron
+    { TELLENC_LANG_SK, 0xf3, 0xf3, 11 },        // o acute
+    { TELLENC_LANG_SK, 0xf4, 0xf4, 20 },        // o circumflex
+    { TELLENC_LANG_SK, 0x155, 0x155, 2 },       // r acute
+    { TELLENC_LANG_SK, 0x161, 0x161, 60 },      // s caron
+    { TELLENC_LANG_SK, 0x165, 0x165, 50 },      // t caron
+    { TELLENC_LANG_SK, 0xfa, 0xfa, 30 },        // u acute
+    { TELLENC_LANG_SK, 0xfd, 0xfd, 100 },       // y acute
+    { TELLENC_LANG_SK, 0x17e, 0x17e, 70 },      // z caron
+
+    { TELLENC_LANG_SL, 'a', 'z', 0 },
+    { TELLENC_LANG_SL, 0x10d, 0x10d, 150 },     // c caron
+    { TELLENC_LANG_SL, 0x161, 0x161, 65 },      // s caron
+    { TELLENC_LANG_SL, 0x17e, 0x17e, 86 },      // z caron
+
+    { TELLENC_LANG_HU, 'a', 'z', 0 },
+    { TELLENC_LANG_HU, 0xe1, 0xe1, 340 },       // a acute
+    { TELLENC_LANG_HU, 0xe9, 0xe9, 390 },       // e acute
+    { TELLENC_LANG_HU, 0xed, 0xed, 55 },        // i acute
+    { TELLENC_LANG_HU, 0xf3, 0xf3, 100 },       // o acute
+    { TELLENC_LANG_HU, 0xf6, 0xf6, 100 },       // o diaeresis
+    { TELLENC_LANG_HU, 0x151, 0x151, 85 },      // o double acute
+    { TELLENC_LANG_HU, 0xfa, 0xfa, 20 },        // u acute
+    { TELLENC_LANG_HU, 0xfc, 0xfc, 50 },        // u diaeresis
+    { TELLENC_LANG_HU, 0x171, 0x171, 14 },      // u double acute
+
+    { TELLENC_LANG_PL, 'a', 'z', 0 },
+    { TELLENC_LANG_PL, 0x105, 0x105, 99 },      // a ogonek
+    { TELLENC_LANG_PL, 0x107, 0x107, 40 },      // c acute
+    { TELLENC_LANG_PL, 0x119, 0x119, 111 },     // e ogonek
+    { TELLENC_LANG_PL, 0x142, 0x142, 182 },     // l stroke
+    { TELLENC_LANG_PL, 0x144, 0x144, 20 },      // n acute
+    { TELLENC_LANG_PL, 0xf3, 0xf3, 85 },        // o acute
+    { TELLENC_LANG_PL, 0x15b, 0x15b, 66 },      // s acute
+    { TELLENC_LANG_PL, 0x17a, 0x17a, 8 },       // z acute
+    { TELLENC_LANG_PL, 0x17c, 0x17c, 83 },      // z dot
+
+    // Text in other scripts often has ASCII words in it
+    { TELLENC_LANG_RU, 0x430, 0x44f, 0 },
+    { TELLENC_LANG_RU, 'a', 'z', 3000 },
+    { TELLENC_LANG_RU, 0x44b, 0x44b, 130 },     // yery
+    { TELLENC_LANG_RU, 0x44d, 0x44d, 22 },      // e
+    { TELLENC_LANG_RU, 0x44a, 0x44a, 3 },       // hard sign
+    { TELLENC_LANG_RU, 0x451, 0x451, 3 },       // io
+    { TELLENC_LANG_RU, 0x454, 0x454, 1 },       // Ukrainian ie
+    { TELLENC_LANG_RU, 0x456, 0x457, 1 },       // Ukrainian i and yi
+    { TELLENC_LANG_RU, 0x491, 0x491, 1 },       // ghe with upturn
+
+    { TELLENC_LANG_UK, 0x430, 0x44f, 0 },
+    { TELLENC_LANG_UK, 'a', 'z', 3000 },
+    { TELLENC_LANG_UK, 0x456, 0x456, 400 },     // i
+    { TELLENC_LANG_UK, 0x457, 0x457, 40 },      // yi
+    { TELLENC_LANG_UK, 0x454, 0x454, 30 },      // ie
+    { TELLENC_LANG_UK, 0x491, 0x491, 1 },       // ghe with upturn
+    { TELLENC_LANG_UK, 0x44a, 0x44b, 1 },       // Russian hard sign, yery
+    { TELLENC_LANG_UK, 0x44d, 0x44d, 1 },       // Russian e
+    { TELLENC_LANG_UK, 0x451, 0x451, 1 },       // Russian io
+
+    { TELLENC_LANG_EL, 0x3ac, 0x3ce, 0 },
+    { TELLENC_LANG_EL, 'a', 'z', 3000 },
+
+    { TELLENC_LANG_HE, 0x5d0, 0x5ea, 0 },
+    { TELLENC_LANG_HE, 'a', 'z', 3000 },
+
+    { TELLENC_LANG_AR, 0x621, 0x64a, 0 },
+    { TELLENC_LANG_AR, 'a', 'z', 3000 },
+
+    { TELLENC_LANG_TH, 0xe00, 0xe7f, 0 },
+    { TELLENC_LANG_TH, 'a', 'z', 3000 },
+
+    { TELLENC_LANG_ZH, 0x4e00, 0x9fff, 0 },     // Han
+    { TELLENC_LANG_ZH, 'a', 'z', 500 },
+    { TELLENC_LANG_ZH, 0x3040, 0x30ff, 1 },     // kana
+
+    { TELLENC_LANG_JA, 0x4e00, 0x9fff, 0 },
+    { TELLENC_LANG_JA, 'a', 'z', 500 },
+    { TELLENC_LANG_JA, 0x3040, 0x30ff, 5500 },
+
+    { TELLENC_LANG_KO, 0xac00, 0xd7bf, 0 },     // Hangul
+    { TELLENC_LANG_KO, 'a', 'z', 500 },
+    { TELLENC_LANG_KO, 0x4e00, 0x9fff, 50 },
+};
+
+/** Ranges of the letters counted, besides the ASCII ones. */
+static const uint16_t letter_ranges[][2] = {
+    { 0x00c0, 0x024f },     // Latin
+    { 0x0370, 0x052f },     // Greek and Cyrillic
+    { 0x05d0, 0x05ea },     // Hebrew
+    { 0x0621, 0x064a },     // Arabic
+    { 0x0e00, 0x0e7f },     // Thai
+    { 0x3040, 0x30ff },     // Kana
+    { 0x4e00, 0x9fff },     // Han
+    { 0xac00, 0xd7bf },     // Hangul
+};
+
+} // namespace tellenc_detail
+
+/** Static information about an encoding. */
+struct tellenc_encoding_info_t {
+    const char*     name;       ///< Name reported, as used by Vim
+    const char*     iana_name;  ///< Preferred MIME name, or NULL
+    const char*     aliases;    ///< Other names, separated by spaces
+    unsigned char   byte_width; ///< Bytes per code unit; 0 if not text
+    bool            ascii_compatible;   ///< ASCII bytes mean ASCII
+};
+
+namespace tellenc_detail {
+
+static const tellenc_encoding_info_t encoding_info[TELLENC_ENCODING_COUNT] = {
+    { "unknown",      NULL,           "",                           0, false },
+    { "binary",       NULL,           "",                           0, false },
+    { "ascii",        "US-ASCII",     "ansi_x3.4-1968 iso646-us",   1, true  },
+    { "utf-8",        "UTF-8",        "utf8",                       1, true  },
+    { "utf-16",       "UTF-16BE",     "utf-16be ucs-2 ucs-2be",     2, false },
+    { "utf-16le",     "UTF-16LE",     "ucs-2le",                    2, false },
+    { "ucs-4",        "UTF-32BE",     "utf-32 utf-32be ucs-4be",    4, false },
+    { "ucs-4le",      "UTF-32LE",     "utf-32le",                   4, false },
+    { "latin1",       "ISO-8859-1",   "iso8859-1 l1 cp819",         1, true  },
+    { "windows-1250", "windows-1250", "cp1250 x-cp1250",            1, true  },
+    { "windows-1252", "windows-1252", "cp1252 x-cp1252",            1, true  },
+    { "cp437",        "IBM437",       "437 cspc8codepage437",       1, true  },
+    { "gb2312",       "GB2312",       "euc-cn csgb2312",            1, true  },
+    { "gbk",          "GBK",          "cp936 ms936 windows-936",    1, true  },
+    { "big5",         "Big5",         "cp950 csbig5 x-x-big5",      1, true  },
+    { "sjis",         "Shift_JIS",    "shift-jis x-sjis ms_kanji cp932 "
+                                      "windows-31j",                1, true  },
+    { "euc-jp",       "EUC-JP",       "eucjp x-euc-jp",             1, true  },
+    { "euc-kr",       "EUC-KR",       "euckr cp949 ks_c_5601-1987", 1, true  },
+    { "koi8-r",       "KOI8-R",       "koi8r cskoi8r",              1, true  },
+    { "koi8-u",       "KOI8-U",       "koi8u",                      1, true  },
+    { "iso-2022-jp",  "ISO-2022-JP",  "csiso2022jp",                1, false },
+    { "iso-2022-jp-2", "ISO-2022-JP-2", "csiso2022jp2",             1, false },
+    { "iso-2022-kr",  "ISO-2022-KR",  "csiso2022kr",                1, false },
+    { "iso-2022-cn",  "ISO-2022-CN",  "csiso2022cn",                1, false },
+    { "hz-gb-2312",   "HZ-GB-2312",   "hz hz-gb",                   1, false },
+    { "utf-7",        "UTF-7",        "utf7 csunicode11utf7",       1, false },
+    { "gb18030",      "GB18030",      "gb-18030 csgb18030",         1, true  },
+    { "windows-1251", "windows-1251", "cp1251 x-cp1251",            1, true  },
+    { "cp866",        "IBM866",       "866 csibm866",               1, true  },
+    { "iso-8859-5",   "ISO-8859-5",   "iso8859-5 iso_8859-5 cyrillic "
+                                      "csisolatincyrillic",         1, true  },
+    { "x-mac-cyrillic", NULL,         "maccyrillic mac-cyrillic",   1, true  },
+    { "windows-1253", "windows-1253", "cp1253 x-cp1253",            1, true  },
+    { "iso-8859-7",   "ISO-8859-7",   "iso8859-7 iso_8859-7 greek "
+                                      "elot_928 csisolatingreek",   1, true  },
+    { "windows-1255", "windows-1255", "cp1255 x-cp1255",            1, true  },
+    { "iso-8859-8",   "ISO-8859-8",   "iso8859-8 iso_8859-8 hebrew "
+                                      "visual csisolatinhebrew",    1, true  },
+    { "windows-1256", "windows-1256", "cp1256 x-cp1256",            1, true  },
+    { "tis-620",      "TIS-620",      "tis620 iso-8859-11 cp874 "
+                                      "windows-874",                1, true  },
+};
+
+/** ISO 639-1 codes of the languages. */
+static const char* const language_names[TELLENC_LANGUAGE_COUNT] = {
+    "unknown", "en", "fr", "de", "es", "fi", "cs", "sk", "sl", "hu", "pl",
+    "ru", "uk", "el", "he", "ar", "th", "zh", "ja", "ko"
+};
+
+inline bool equal_ignore_case(const char* lhs, const char* rhs, size_t len)
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (tolower((unsigned char)lhs[i]) != tolower((unsigned char)rhs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool is_name_of(const char* name, size_t len, const char* candidate)
+{
+    return candidate && strlen(candidate) == len &&
+           equal_ignore_case(name, candidate, len);
+}
+
+inline bool is_alias_of(const char* name, size_t len, const char* aliases)
+{
+    while (*aliases) {
+        const char* end = strchr(aliases, ' ');
+        size_t alias_len = end ? size_t(end - aliases) : strlen(aliases);
+        if (alias_len == len && equal_ignore_case(name, aliases, len)) {
+            return true;
+        }
+        aliases += alias_len;
+        if (*aliases) {
+            ++aliases;
+        }
+    }
+    return false;
+}
+
+inline tellenc_encoding_t encoding_of_name(const char* name, size_t len)
+{
+    for (int i = TELLENC_BINARY; i < TELLENC_ENCODING_COUNT; ++i) {
+        const tellenc_encoding_info_t& info = encoding_info[i];
+        if (is_name_of(name, len, info.name) ||
+                is_name_of(name, len, info.iana_name) ||
+                is_alias_of(name, len, info.aliases)) {
+            return tellenc_encoding_t(i);
+        }
+    }
+    return TELLENC_UNKNOWN;
+}
+
+inline bool is_charset_char(unsigned char ch)
+{
+    return (ch >= '0' && ch <= '9') ||
+           ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'z') ||
+           ch == '-' || ch == '_' || ch == '.' || ch == ':';
+}
+
+/** Checks whether the '=' at \a pos follows \a key, ignoring case. */
+inline bool is_key_before(const unsigned char* buf, size_t pos,
+                          const char* key, size_t key_len)
+{
+    while (pos > 0 && (buf[pos - 1] == ' ' || buf[pos - 1] == '\t')) {
+        --pos;
+    }
+    if (pos < key_len ||
+            (pos > key_len && is_charset_char(buf[pos - key_len - 1]))) {
+        return false;
+    }
+    return equal_ignore_case((const char*)buf + pos - key_len, key, key_len);
+}
+
+/**
+ * Gets the encoding named after the '=' at \a pos, like "utf-8" in
+ * charset="utf-8"; TELLENC_UNKNOWN if the name is unknown or cut by the
+ * end of the buffer.
+ */
+inline tellenc_encoding_t read_declared_name(const unsigned char* buf,
+                                             size_t len, size_t pos)
+{
+    size_t i = pos + 1;
+    while (i < len && (buf[i] == ' ' || buf[i] == '\t')) {
+        ++i;
+    }
+    if (i < len && (buf[i] == '"' || buf[i] == '\'')) {
+        ++i;
+    }
+    size_t start = i;
+    while (i < len && i - start <= MAX_CHARSET_NAME &&
+           is_charset_char(buf[i])) {
+        ++i;
+    }
+    if (i == start || i == len || is_charset_char(buf[i])) {
+        return TELLENC_UNKNOWN;
+    }
+    return encoding_of_name((const char*)buf + start, i - start);
+}
+
+/**
+ * Finds a charset declared in the first bytes: charset= in an HTML meta
+ * tag or a Content-Type header, or encoding= in an XML declaration.
+ * Only the '=' signs found by memchr are looked at.
+ */
+inline tellenc_encoding_t sniff_declared(const unsigned char* buf,
+                                         size_t len)
+{
+    // An XML declaration is only allowed at the start
+    size_t xml_end = 0;
+    if (len >= 5 && memcmp(buf, "<?xml", 5) == 0) {
+        const void* end = memchr(buf, '>', len);
+        xml_end = end ? size_t((const unsigned char*)end - buf) : len;
+    }
+
+    const unsigned char* const end = buf + len;
+    const unsigned char* ptr = buf;
+    while ((ptr = (const unsigned char*)memchr(ptr, '=', end - ptr))) {
+        size_t pos = ptr++ - buf;
+        if (is_key_before(buf, pos, "charset", 7) ||
+                (pos < xml_end && is_key_before(buf, pos, "encoding", 8))) {
+            tellenc_encoding_t enc = read_declared_name(buf, len, pos);
+            if (enc != TELLENC_UNKNOWN) {
+                return enc;
+            }
+        }
+    }
+    return TELLENC_UNKNOWN;
+}
+
+
+static inline bool is_non_text(char ch)
+{
+    for (size_t i = 0; i < sizeof(NON_TEXT_CHARS); ++i) {
+        if (ch == NON_TEXT_CHARS[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** Clears the letter counts for the language, only those in use. */
+inline void clear_language_counts(tellenc_workspace_t& ws)
+{
+    for (uint32_t i = 0; i < ws.lang_slot_cnt; ++i) {
+        uint16_t slot = ws.lang_slots[i];
+        if (slot < MAX_LANGUAGE_CP) {
+            ws.lang_cp_cnt[slot] = 0;
+        } else {
+            ws.lang_block_cnt[slot - MAX_LANGUAGE_CP] = 0;
+        }
+    }
+    ws.lang_slot_cnt = 0;
+}
+
+inline void reset_state(tellenc_workspace_t& ws)
+{
+    ws.pos = 0;
+    ws.utf8_state = UTF8_1;
+    ws.last_ch = EOF;
+    ws.gb4_state = GB4_NONE;
+    ws.prev_ch = 0;
+    ws.head_len = 0;
+    ws.head_enc = TELLENC_UNKNOWN;
+    ws.sole_enc = TELLENC_UNKNOWN;
+    ws.decl_len = 0;
+    ws.declared_enc = TELLENC_UNKNOWN;
+    ws.nul_count_byte[EVEN] = ws.nul_count_byte[ODD] = 0;
+    ws.nul_count_word[EVEN] = ws.nul_count_word[ODD] = 0;
+    ws.is_binary = false;
+    ws.is_valid_utf8 = true;
+    ws.is_mostly_utf8 = true;
+    ws.utf8_errors = 0;
+    ws.utf8_error_end = 0;
+    ws.is_valid_latin1 = true;
+    ws.dbcs_valid = DBCS_ALL;
+    ws.dbcs_pending = ws.dbcs_pending2 = 0;
+    ws.crlf_cnt = 0;
+    ws.tab_indent_cnt = ws.space_indent_cnt = 0;
+    ws.is_line_start = true;
+    ws.eol_end = 0;
+    ws.utf8_cp = 0;
+    ws.utf8_char_start = ws.utf8_char_end = 0;
+    clear_language_counts(ws);
+    ws.language = TELLENC_LANG_UNKNOWN;
+    ws.language_confidence = 0;
+    ws.decided_by = NULL;
+    ws.confidence = 0;
+    ws.utf8_double_need = 0;
+    ws.utf8_double_run = 0;
+    ws.utf8_char_cnt = ws.utf8_double_cnt = 0;
+    ws.dbyte_cnt = 0;
+    ws.dbyte_hihi_cnt = 0;
+    ws.gb18030_cnt = ws.gb18030_errors = 0;
+    memset(ws.sbyte_char_cnt, 0, sizeof ws.sbyte_char_cnt);
+    memset(ws.utf16_class_cnt, 0, sizeof ws.utf16_class_cnt);
+    ws.utf16_surrogate_errors[UTF16_BE] = 0;
+    ws.utf16_surrogate_errors[UTF16_LE] = 0;
+    ws.utf16_in_pair[UTF16_BE] = ws.utf16_in_pair[UTF16_LE] = false;
+    ws.utf16_latin_cnt = 0;
+    ws.ucs4_word = 0;
+    ws.ucs4_valid[UCS4_BE] = ws.ucs4_valid[UCS4_LE] = true;
+    ws.ucs4_printable_cnt[UCS4_BE] = ws.ucs4_printable_cnt[UCS4_LE] = 0;
+    ws.is_7bit = true;
+    ws.esc_state = ESC_NONE;
+    ws.esc_mode = ESC_MODE_ASCII;
+    ws.esc_half = false;
+    ws.esc_so_designated = false;
+    memset(ws.esc_cnt, 0, sizeof ws.esc_cnt);
+    ws.iso2022_errors = ws.hz_errors = ws.utf7_errors = 0;
+
+    // Only the double-bytes seen last time need to be cleared
+    for (uint32_t i = 0; i < ws.dbyte_uniq_cnt; ++i) {
+        ws.dbyte_char_cnt[ws.dbyte_chars[i] - MAX_DBYTE] = 0;
+    }
+    ws.dbyte_uniq_cnt = 0;
+    ws.dbyte_scale = 0;
+    ws.dbyte_count_bound = 0;
+    ws.dbyte_sketch.size = 0;
+    memset(ws.dbyte_sketch.buckets, 0, sizeof ws.dbyte_sketch.buckets);
+}
+
+inline void print_sbyte_char_cnt(const tellenc_workspace_t& ws)
+{
+    unsigned char sbyte_chars[MAX_CHAR];
+    for (size_t i = 0; i < MAX_CHAR; ++i) {
+        sbyte_chars[i] = (unsigned char)i;
+    }
+    std::sort(sbyte_chars, sbyte_chars + MAX_CHAR,
+              greater_sbyte_count(ws.sbyte_char_cnt));
+    for (size_t i = 0; i < MAX_CHAR; ++i) {
+        unsigned char ch = sbyte_chars[i];
+        if (ws.sbyte_char_cnt[ch] == 0)
+            break;
+        printf("%.2x ('%c'): %-6.0f    ", ch,
+               isprint(ch) ? ch : '?', double(ws.sbyte_char_cnt[ch]));
+    }
+    printf("\n");
+}
+
+inline void print_dbyte_char_cnt(const tellenc_workspace_t& ws)
+{
+    for (uint32_t i = 0; i < ws.dbyte_uniq_cnt; ++i) {
+        uint16_t dbyte = ws.dbyte_chars[i];
+        printf("%.4x: %-6.0f        ", dbyte,
+               ldexp(double(ws.dbyte_char_cnt[dbyte - MAX_DBYTE]),
+                     ws.dbyte_scale));
+    }
+    printf("\n");
+}
+
+inline tellenc_encoding_t check_ucs_bom(const unsigned char* const buffer,
+                                        const size_t len)
+{
+    const struct pattern_t {
+        tellenc_encoding_t enc;
+        const char* pattern;
+        size_t pattern_len;
+    } patterns[] = {
+        { TELLENC_UCS_4,     "\x00\x00\xFE\xFF",  4 },
+        { TELLENC_UCS_4LE,   "\xFF\xFE\x00\x00",  4 },
+        { TELLENC_UTF_8,     "\xEF\xBB\xBF",      3 },
+        { TELLENC_UTF_16,    "\xFE\xFF",          2 },
+        { TELLENC_UTF_16LE,  "\xFF\xFE",          2 },
+        { TELLENC_UNKNOWN,   NULL,                0 }
+    };
+    for (size_t i = 0; patterns[i].pattern; ++i) {
+        const pattern_t& item = patterns[i];
+        if (len >= item.pattern_len &&
+            memcmp(buffer, item.pattern, item.pattern_len) == 0) {
+            return item.enc;
+        }
+    }
+    return TELLENC_UNKNOWN;
+}
+
+/**
+ * Checks whether an encoding may be reported: enabled by the policy and
+ * a candidate of the workspace.
+ */
+template <typename Policy>
+inline bool is_enabled(const tellenc_workspace_t& ws, tellenc_encoding_t enc)
+{
+    return Policy::enabled(enc) && ws.is_candidate[enc];
+}
+
+/**
+ * Checks whether an encoding is to be looked for: Windows-1252 and GBK
+ * are also needed to find their subsets Latin1 and GB2312.
+ */
+template <typename Policy>
+inline bool is_wanted(const tellenc_workspace_t& ws, tellenc_encoding_t enc)
+{
+    return is_enabled<Policy>(ws, enc) ||
+           (enc == TELLENC_WINDOWS_1252 &&
+            is_enabled<Policy>(ws, TELLENC_LATIN1)) ||
+           (enc == TELLENC_GBK && is_enabled<Policy>(ws, TELLENC_GB2312));
+}
+
+template <typename Policy>
+inline bool is_wanted_escapes(const tellenc_workspace_t& ws)
+{
+    return is_enabled<Policy>(ws, TELLENC_ISO_2022_JP) ||
+           is_enabled<Policy>(ws, TELLENC_ISO_2022_JP_2) ||
+           is_enabled<Policy>(ws, TELLENC_ISO_2022_KR) ||
+           is_enabled<Policy>(ws, TELLENC_ISO_2022_CN) ||
+           is_enabled<Policy>(ws, TELLENC_HZ) ||
+           is_enabled<Policy>(ws, TELLENC_UTF_7);
+}
+
+template <typename Policy>
+inline bool is_wanted_utf16_32(const tellenc_workspace_t& ws)
+{
+    return is_enabled<Policy>(ws, TELLENC_UTF_16) ||
+           is_enabled<Policy>(ws, TELLENC_UTF_16LE) ||
+           is_enabled<Policy>(ws, TELLENC_UCS_4) ||
+           is_enabled<Policy>(ws, TELLENC_UCS_4LE);
+}
+
+/** Checks whether the double-byte frequencies are needed. */
+template <typename Policy>
+inline bool is_wanted_freq_tables(const tellenc_workspace_t& ws)
+{
+#define TELLENC_IS_WANTED(enc, table) || is_wanted<Policy>(ws, enc)
+    return false TELLENC_FREQ_TABLES(TELLENC_IS_WANTED)
+                 TELLENC_SBYTE_MODELS(TELLENC_IS_WANTED);
+#undef TELLENC_IS_WANTED
+}
+
+template <typename Policy>
+inline bool is_wanted_sbyte_models(const tellenc_workspace_t& ws)
+{
+#define TELLENC_IS_WANTED(enc, name) || is_enabled<Policy>(ws, enc)
+    return false TELLENC_SBYTE_MODELS(TELLENC_IS_WANTED);
+#undef TELLENC_IS_WANTED
+}
+
+template <size_t N>
+inline bool has_dbyte(const uint16_t (&table)[N], uint16_t dbyte)
+{
+    for (size_t i = 0; i < N; ++i) {
+        if (dbyte == table[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Finds the encoding whose table has the most frequent double-byte, the
+ * counts weighted by the priors of the encodings.  Without priors, it is
+ * the first table that has the most frequent double-byte in it.
+ */
+template <typename Policy>
+inline tellenc_encoding_t search_freq_dbytes(const tellenc_workspace_t& ws)
+{
+    size_t max_comp_idx = MAX_COMP_IDX;
+    if (max_comp_idx > ws.dbyte_uniq_cnt) {
+        max_comp_idx = ws.dbyte_uniq_cnt;
+    }
+    tellenc_encoding_t best_enc = TELLENC_UNKNOWN;
+    double best_score = 0;
+    for (size_t i = 0; i < max_comp_idx; ++i) {
+        uint16_t dbyte = ws.dbyte_chars[i];
+        double cnt = ws.dbyte_char_cnt[dbyte - MAX_DBYTE];
+        if (cnt * ws.max_prior <= best_score) {
+            break;
+        }
+#define TELLENC_CHECK_FREQ_TABLE(enc, table)                            \
+        if (is_wanted<Policy>(ws, enc) &&                               \
+                cnt * ws.priors[enc] > best_score &&                    \
+                has_dbyte(table, dbyte)) {                              \
+            if (ws.verbose) {                                           \
+                printf("Found frequent double-byte %.4x\n", dbyte);     \
+            }                                                           \
+            best_enc = enc;                                             \
+            best_score = cnt * ws.priors[enc];                          \
+        }
+        TELLENC_FREQ_TABLES(TELLENC_CHECK_FREQ_TABLE)
+#undef TELLENC_CHECK_FREQ_TABLE
+    }
+    return best_enc;
+}
+
+/**
+ * Gets the share of \a enc in its score of search_freq_dbytes and that of
+ * the runner-up, each table scored by its most frequent double-byte.
+ */
+template <typename Policy>
+inline double freq_dbyte_share(const tellenc_workspace_t& ws,
+                               tellenc_encoding_t enc)
+{
+    size_t max_comp_idx = MAX_COMP_IDX;
+    if (max_comp_idx > ws.dbyte_uniq_cnt) {
+        max_comp_idx = ws.dbyte_uniq_cnt;
+    }
+    double own_score = 0;
+    double other_score = 0;
+#define TELLENC_SCORE_FREQ_TABLE(table_enc, table)                      \
+    if (is_wanted<Policy>(ws, table_enc)) {                             \
+        for (size_t i = 0; i < max_comp_idx; ++i) {                     \
+            uint16_t dbyte = ws.dbyte_chars[i];                         \
+            if (has_dbyte(table, dbyte)) {                              \
+                double score = ws.dbyte_char_cnt[dbyte - MAX_DBYTE] *   \
+                               ws.priors[table_enc];                    \
+                if (table_enc == enc) {                                 \
+                    own_score = score;                                  \
+                } else if (score > other_score) {                       \
+                    other_score = score;                                \
+                }                                                       \
+                break;                                                  \
+            }                                                           \
+        }                                                               \
+    }
+    TELLENC_FREQ_TABLES(TELLENC_SCORE_FREQ_TABLE)
+#undef TELLENC_SCORE_FREQ_TABLE
+    return own_score > 0 ? own_score / (own_score + other_score) : 0;
+}
+
+/** Recognized escape sequences, without the ESC. */
+struct escape_seq_t {
+    const char*     seq;
+    unsigned char   kind;       ///< Escape_Kind, or ESC_KIND_COUNT if none
+    unsigned char   mode;       ///< Escape_Mode after it, or ESC_MODE_COUNT
+};
+
+static const escape_seq_t escape_seqs[] = {
+    { "(B",  ESC_ISO_2022_JP,   ESC_MODE_ASCII },
+    { "(J",  ESC_ISO_2022_JP,   ESC_MODE_ASCII },
+    { "(I",  ESC_ISO_2022_JP,   ESC_MODE_ASCII },
+    { "$@",  ESC_ISO_2022_JP,   ESC_MODE_DBCS },
+    { "$B",  ESC_ISO_2022_JP,   ESC_MODE_DBCS },
+    { "$A",  ESC_ISO_2022_JP_2, ESC_MODE_DBCS },
+    { "$(A", ESC_ISO_2022_JP_2, ESC_MODE_DBCS },
+    { "$(C", ESC_ISO_2022_JP_2, ESC_MODE_DBCS },
+    { "$(D", ESC_ISO_2022_JP_2, ESC_MODE_DBCS },
+    { ".A",  ESC_ISO_2022_JP_2, ESC_MODE_COUNT },
+    { ".F",  ESC_ISO_2022_JP_2, ESC_MODE_COUNT },
+    { "N",   ESC_KIND_COUNT,    ESC_MODE_COUNT },   // single shift 2
+    { "$)C", ESC_ISO_2022_KR,   ESC_MODE_COUNT },
+    { "$)A", ESC_ISO_2022_CN,   ESC_MODE_COUNT },
+    { "$)G", ESC_ISO_2022_CN,   ESC_MODE_COUNT },
+    { "$*H", ESC_ISO_2022_CN,   ESC_MODE_COUNT },
+};
+
+inline int base64_value(unsigned char ch)
+{
+    if (ch >= 'A' && ch <= 'Z') {
+        return ch - 'A';
+    } else if (ch >= 'a' && ch <= 'z') {
+        return ch - 'a' + 26;
+    } else if (ch >= '0' && ch <= '9') {
+        return ch - '0' + 52;
+    } else if (ch == '+') {
+        return 62;
+    } else if (ch == '/') {
+        return 63;
+    }
+    return -1;
+}
+
+inline void set_escape_mode(tellenc_workspace_t& ws, unsigned char mode,
+                            tellenc_count_t& errors)
+{
+    // A double-byte must not be cut by a shift
+    if (ws.esc_half) {
+        errors++;
+        ws.esc_half = false;
+    }
+    ws.esc_mode = mode;
+}
+
+/** Checks an escape sequence collected so far. */
+inline void check_escape_seq(tellenc_workspace_t& ws)
+{
+    bool is_prefix = false;
+    for (size_t i = 0; i < sizeof escape_seqs / sizeof escape_seqs[0]; ++i) {
+        const escape_seq_t& item = escape_seqs[i];
+        size_t seq_len = strlen(item.seq);
+        if (seq_len < ws.esc_seq_len ||
+                memcmp(item.seq, ws.esc_seq, ws.esc_seq_len) != 0) {
+            continue;
+        }
+        if (seq_len > ws.esc_seq_len) {
+            is_prefix = true;
+            continue;
+        }
+        if (item.kind != ESC_KIND_COUNT) {
+            ws.esc_cnt[item.kind]++;
+        }
+        if (item.kind == ESC_ISO_2022_KR || item.kind == ESC_ISO_2022_CN) {
+            ws.esc_so_designated = true;
+        }
+        if (item.mode != ESC_MODE_COUNT) {
+            set_escape_mode(ws, item.mode, ws.iso2022_errors);
+        }
+        ws.esc_state = ESC_NONE;
+        return;
+    }
+    if (!is_prefix || ws.esc_seq_len == sizeof ws.esc_seq) {
+        ws.iso2022_errors++;
+        ws.esc_state = ESC_NONE;
+    }
+}
+
+/**
+ * Gets the script of a UTF-16 code unit, roughly by its high byte; -1 for
+ * Latin1 and punctuation, which go with any script.
+ */
+inline int utf16_script(uint32_t unit)
+{
+    uint32_t high_byte = unit >> 8;
+    if (high_byte == 0x00 || high_byte == 0x20 || high_byte == 0x30 ||
+            high_byte == 0xff) {
+        return -1;
+    } else if ((high_byte >= 0x34 && high_byte <= 0x9f) ||
+               high_byte == 0xf9 || high_byte == 0xfa) {
+        return 0x34;    // Han
+    } else if (high_byte >= 0xac && high_byte <= 0xd7) {
+        return 0xac;    // Hangul
+    }
+    return int(high_byte);
+}
+
+/**
+ * Checks a unit decoded from a UTF-7 run.  Real text stays in one
+ * script, while ASCII words after a '+' decode to a mixture.
+ */
+inline void check_utf7_unit(tellenc_workspace_t& ws, uint32_t unit)
+{
+    int script = utf16_script(unit);
+    ws.utf7_has_unit = true;
+    if (script >= 0) {
+        if (ws.utf7_script < 0) {
+            ws.utf7_script = script;
+        } else if (ws.utf7_script != script) {
+            ws.utf7_script = INT_MAX;   // mixed
+        }
+    }
+}
+
+/** Ends a base64 run of UTF-7, which must leave no bits of a unit. */
+inline void end_utf7_run(tellenc_workspace_t& ws)
+{
+    if (ws.utf7_bit_cnt >= 6 || ws.utf7_bits != 0 || !ws.utf7_has_unit ||
+            ws.utf7_script == INT_MAX) {
+        ws.utf7_errors++;
+    } else {
+        ws.esc_cnt[ESC_UTF_7]++;
+    }
+    ws.esc_mode = ESC_MODE_ASCII;
+}
+
+/**
+ * Follows the escape sequences and shifts of ISO-2022, HZ and UTF-7 for
+ * a byte flagged in escape_char_table, or any byte in a shifted state.
+ *
+ * @return  \c false if the byte is not 7-bit, after which the text needs
+ *          no more checks
+ */
+inline bool scan_escape(tellenc_workspace_t& ws, unsigned char ch)
+{
+    if (ch >= 0x80) {
+        ws.is_7bit = false;
+        return false;
+    }
+
+    switch (ws.esc_state) {
+    case ESC_SEQ:
+        ws.esc_seq[ws.esc_seq_len++] = ch;
+        check_escape_seq(ws);
+        return true;
+    case ESC_TILDE:
+        ws.esc_state = ESC_NONE;
+        if (ch == '{' && ws.esc_mode == ESC_MODE_ASCII) {
+            ws.esc_cnt[ESC_HZ]++;
+            ws.esc_mode = ESC_MODE_HZ;
+        } else if (ch == '}' && ws.esc_mode == ESC_MODE_HZ) {
+            set_escape_mode(ws, ESC_MODE_ASCII, ws.hz_errors);
+        } else if (ch != '~' && ch != '\n') {
+            ws.hz_errors++;
+        }
+        return true;
+    case ESC_PLUS:
+        ws.esc_state = ESC_NONE;
+        if (ch == '-') {
+            return true;    // "+-" is '+'
+        } else if (base64_value(ch) < 0) {
+            ws.utf7_errors++;
+            break;
+        }
+        ws.esc_mode = ESC_MODE_UTF7;
+        ws.utf7_bits = 0;
+        ws.utf7_bit_cnt = 0;
+        ws.utf7_has_unit = false;
+        ws.utf7_script = -1;
+        break;
+    }
+
+    switch (ws.esc_mode) {
+    case ESC_MODE_UTF7: {
+        int value = base64_value(ch);
+        if (value >= 0) {
+            ws.utf7_bits = (ws.utf7_bits << 6) | value;
+            ws.utf7_bit_cnt += 6;
+            if (ws.utf7_bit_cnt >= 16) {
+                ws.utf7_bit_cnt -= 16;
+                check_utf7_unit(ws, ws.utf7_bits >> ws.utf7_bit_cnt);
+                ws.utf7_bits &= (1U << ws.utf7_bit_cnt) - 1;
+            }
+            return true;
+        }
+        end_utf7_run(ws);
+        if (ch == '-') {
+            return true;
+        }
+        break;
+    }
+    case ESC_MODE_DBCS:
+    case ESC_MODE_SHIFT_OUT:
+    case ESC_MODE_HZ: {
+        tellenc_count_t& errors = ws.esc_mode == ESC_MODE_HZ
+                                  ? ws.hz_errors : ws.iso2022_errors;
+        if (ch >= 0x21 && ch <= 0x7e &&
+                !(ch == '~' && ws.esc_mode == ESC_MODE_HZ && !ws.esc_half)) {
+            ws.esc_half = !ws.esc_half;
+            return true;
+        } else if (ch == '\r' || ch == '\n') {
+            // The shift must end before the line does
+            errors++;
+            set_escape_mode(ws, ESC_MODE_ASCII, errors);
+            return true;
+        } else if (ch == 0x0f && ws.esc_mode == ESC_MODE_SHIFT_OUT) {
+            set_escape_mode(ws, ESC_MODE_ASCII, errors);
+            return true;
+        }
+        break;
+    }
+    }
+
+    switch (ch) {
+    case 0x1b:
+        ws.esc_state = ESC_SEQ;
+        ws.esc_seq_len = 0;
+        break;
+    case 0x0e:
+        if (ws.esc_so_designated) {
+            set_escape_mode(ws, ESC_MODE_SHIFT_OUT, ws.iso2022_errors);
+        } else {
+            ws.iso2022_errors++;
+        }
+        break;
+    case '~':
+        if (ws.esc_mode == ESC_MODE_ASCII || ws.esc_mode == ESC_MODE_HZ) {
+            ws.esc_state = ESC_TILDE;
+        }
+        ws.utf7_errors++;   // never a direct character in UTF-7
+        break;
+    case '\\':
+        ws.utf7_errors++;
+        break;
+    case '+':
+        if (ws.esc_mode == ESC_MODE_ASCII) {
+            ws.esc_state = ESC_PLUS;
+        }
+        break;
+    }
+    return true;
+}
+
+inline unsigned char hash_dbyte(uint16_t dbyte)
+{
+    return (unsigned char)((dbyte >> 8) * 31 + dbyte);
+}
+
+/** Gets the entry of a double-byte in a sketch plus one, or 0 if none. */
+inline uint32_t find_in_sketch(const tellenc_dbyte_sketch_t& sketch,
+                               uint16_t dbyte)
+{
+    uint32_t i = sketch.buckets[hash_dbyte(dbyte)];
+    while (i != 0 && sketch.dbytes[i - 1] != dbyte) {
+        i = sketch.next[i - 1];
+    }
+    return i;
+}
+
+/**
+ * Gets how often a double-byte not kept in a sketch may have occurred:
+ * the smallest count if the sketch is full, or 0 if nothing was dropped.
+ */
+inline tellenc_count_t sketch_min_count(const tellenc_dbyte_sketch_t& sketch)
+{
+    return sketch.size < DBYTE_SKETCH_SIZE ? 0
+                                           : sketch.counts[sketch.heap[0]];
+}
+
+/**
+ * Moves the entry at \a pos of the sketch heap down while its count is
+ * above that of a child.
+ */
+inline void sift_down_sketch(tellenc_dbyte_sketch_t& sketch, uint32_t pos)
+{
+    unsigned char entry = sketch.heap[pos];
+    tellenc_count_t count = sketch.counts[entry];
+    for (;;) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= sketch.size) {
+            break;
+        }
+        if (child + 1 < sketch.size &&
+                sketch.counts[sketch.heap[child + 1]] <
+                sketch.counts[sketch.heap[child]]) {
+            ++child;
+        }
+        if (count <= sketch.counts[sketch.heap[child]]) {
+            break;
+        }
+        sketch.heap[pos] = sketch.heap[child];
+        sketch.heap_pos[sketch.heap[pos]] = (unsigned char)pos;
+        pos = child;
+    }
+    sketch.heap[pos] = entry;
+    sketch.heap_pos[entry] = (unsigned char)pos;
+}
+
+/**
+ * Adds \a count occurrences of a double-byte to a sketch, whose count may
+ * already be too high by \a error.  When the sketch is full, the entry of
+ * the smallest count, at the top of the heap, is taken over, and that
+ * count becomes the error.
+ */
+inline void add_to_sketch(tellenc_dbyte_sketch_t& sketch, uint16_t dbyte,
+                          tellenc_count_t count, tellenc_count_t error)
+{
+    unsigned char hash = hash_dbyte(dbyte);
+    uint32_t i = find_in_sketch(sketch, dbyte);
+    if (i != 0) {
+        --i;
+    } else {
+        if (sketch.size < DBYTE_SKETCH_SIZE) {
+            // A new entry has the smallest count and goes up to the top
+            i = sketch.size++;
+            uint32_t pos = i;
+            while (pos != 0) {
+                uint32_t parent = (pos - 1) / 2;
+                sketch.heap[pos] = sketch.heap[parent];
+                sketch.heap_pos[sketch.heap[pos]] = (unsigned char)pos;
+                pos = parent;
+            }
+            sketch.heap[0] = (unsigned char)i;
+            sketch.heap_pos[i] = 0;
+            sketch.counts[i] = 0;
+            sketch.errors[i] = 0;
+        } else {
+            i = sketch.heap[0];
+            unsigned char* link =
+                &sketch.buckets[hash_dbyte(sketch.dbytes[i])];
+            while (*link != i + 1) {
+                link = &sketch.next[*link - 1];
+            }
+            *link = sketch.next[i];
+            sketch.errors[i] = sketch.counts[i];
+        }
+        sketch.dbytes[i] = dbyte;
+        sketch.next[i] = sketch.buckets[hash];
+        sketch.buckets[hash] = (unsigned char)(i + 1);
+    }
+    sketch.counts[i] += count;
+    sketch.errors[i] += error;
+    sift_down_sketch(sketch, sketch.heap_pos[i]);
+}
+
+/** Double-byte of a sketch with its count and error, when merging. */
+struct sketch_entry {
+    tellenc_count_t count;
+    tellenc_count_t error;
+    uint16_t        dbyte;
+};
+
+inline bool greater_sketch_count(const sketch_entry& lhs,
+                                 const sketch_entry& rhs)
+{
+    return lhs.count > rhs.count;
+}
+
+/**
+ * Copies the double-bytes of the sketch to the dense counts, scaled down
+ * if they do not fit.
+ */
+inline void copy_dbyte_sketch(tellenc_workspace_t& ws)
+{
+    const tellenc_dbyte_sketch_t& sketch = ws.dbyte_sketch;
+    tellenc_count_t max_cnt = 0;
+    for (uint32_t i = 0; i < sketch.size; ++i) {
+        max_cnt = std::max(max_cnt, sketch.counts[i]);
+    }
+    ws.dbyte_scale = 0;
+    while ((max_cnt >> ws.dbyte_scale) > MAX_DBYTE_COUNT) {
+        ws.dbyte_scale++;
+    }
+    for (uint32_t i = 0; i < sketch.size; ++i) {
+        ws.dbyte_chars[i] = sketch.dbytes[i];
+        ws.dbyte_char_cnt[sketch.dbytes[i] - MAX_DBYTE] =
+            uint32_t(sketch.counts[i] >> ws.dbyte_scale);
+    }
+    ws.dbyte_uniq_cnt = sketch.size;
+}
+
+/**
+ * Halves the dense double-byte counts, which keeps their ranking; those
+ * that become zero are dropped.
+ */
+inline void halve_dbyte_counts(tellenc_workspace_t& ws)
+{
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < ws.dbyte_uniq_cnt; ++i) {
+        uint16_t dbyte = ws.dbyte_chars[i];
+        if ((ws.dbyte_char_cnt[dbyte - MAX_DBYTE] >>= 1) != 0) {
+            ws.dbyte_chars[kept++] = dbyte;
+        }
+    }
+    ws.dbyte_uniq_cnt = kept;
+    ws.dbyte_count_bound = (ws.dbyte_count_bound + 1) / 2;
+    ws.dbyte_scale++;
+}
+
+/**
+ * Makes sure that the dense double-byte counts cannot overflow in a block
+ * of \a len bytes, each of which ends at most one double-byte.
+ */
+inline void reserve_dbyte_counts(tellenc_workspace_t& ws, size_t len)
+{
+    if (ws.use_dbyte_sketch) {
+        return;
+    }
+    while (ws.dbyte_count_bound > MAX_DBYTE_COUNT - len) {
+        halve_dbyte_counts(ws);
+    }
+    ws.dbyte_count_bound += len;
+}
+
+inline void count_dbyte(tellenc_workspace_t& ws, int first, int second,
+                        bool count_dbyte_chars)
+{
+    if (count_dbyte_chars && ws.use_dbyte_sketch) {
+        add_to_sketch(ws.dbyte_sketch,
+                      (uint16_t)((first << 8) + second), 1, 0);
+    } else if (count_dbyte_chars) {
+        uint16_t dbyte_char = (uint16_t)((first << 8) + second);
+        if (ws.dbyte_char_cnt[dbyte_char - MAX_DBYTE]++ == 0) {
+            ws.dbyte_chars[ws.dbyte_uniq_cnt++] = dbyte_char;
+        }
+    }
+    ws.dbyte_cnt++;
+    if (first > 0xa0 && second > 0xa0) {
+        ws.dbyte_hihi_cnt++;
+    }
+}
+
+/** Counts the high byte and the digit of a broken GB18030 sequence. */
+inline void count_broken_gb4(tellenc_workspace_t& ws, bool count_dbyte_chars)
+{
+    ws.gb18030_errors++;
+    count_dbyte(ws, ws.gb4_bytes[0], ws.gb4_bytes[1], count_dbyte_chars);
+}
+
+/**
+ * Gets the byte that a character comes from when decoded as Windows-1252
+ * or Latin1, or -1.
+ */
+inline int windows_1252_byte_of(uint32_t cp)
+{
+    if (cp < 0x100) {
+        return int(cp);
+    }
+    for (int i = 0; i < 32; ++i) {
+        if (windows_1252_chars[i] == cp) {
+            return 0x80 + i;
+        }
+    }
+    return -1;
+}
+
+/** Gets the lowercase of a Latin, Greek or Cyrillic letter. */
+inline uint32_t fold_case(uint32_t cp)
+{
+    if (cp >= 0xc0 && cp <= 0xde && cp != 0xd7) {
+        return cp + 0x20;
+    } else if (cp >= 0x100 && cp <= 0x17f) {
+        if (cp == 0x178) {
+            return 0xff;
+        } else if ((cp >= 0x139 && cp <= 0x148) ||
+                   (cp >= 0x179 && cp <= 0x17e)) {
+            return cp + (cp & 1);
+        } else if (cp != 0x138 && cp != 0x149 && cp != 0x17f) {
+            return cp | 1;
+        }
+    } else if (cp >= 0x391 && cp <= 0x3ab && cp != 0x3a2) {
+        return cp + 0x20;
+    } else if (cp >= 0x386 && cp <= 0x38f) {
+        switch (cp) {
+        case 0x386:
+            return 0x3ac;
+        case 0x388:
+        case 0x389:
+        case 0x38a:
+            return cp + 0x25;
+        case 0x38c:
+            return 0x3cc;
+        case 0x38e:
+        case 0x38f:
+            return cp + 0x3f;
+        }
+    } else if (cp >= 0x400 && cp <= 0x40f) {
+        return cp + 0x50;
+    } else if (cp >= 0x410 && cp <= 0x42f) {
+        return cp + 0x20;
+    } else if (cp >= 0x490 && cp <= 0x4bf) {
+        return cp | 1;
+    }
+    return cp;
+}
+
+/**
+ * Adds \a cnt (nonzero) of a case-folded non-ASCII character for the
+ * language: one by one below MAX_LANGUAGE_CP, by blocks of 64 in the rest
+ * of the BMP.
+ */
+inline void add_language_count(tellenc_workspace_t& ws, uint32_t cp,
+                               tellenc_count_t cnt)
+{
+    tellenc_count_t* slot_cnt;
+    uint16_t slot;
+    if (cp < MAX_LANGUAGE_CP) {
+        slot_cnt = &ws.lang_cp_cnt[cp];
+        slot = (uint16_t)cp;
+    } else if (cp < LANGUAGE_BLOCKS * 64) {
+        slot_cnt = &ws.lang_block_cnt[cp >> 6];
+        slot = (uint16_t)(MAX_LANGUAGE_CP + (cp >> 6));
+    } else {
+        return;
+    }
+    if (*slot_cnt == 0) {
+        ws.lang_slots[ws.lang_slot_cnt++] = slot;
+    }
+    *slot_cnt += cnt;
+}
+
+/** Counts a non-ASCII character for the language. */
+inline void count_code_point(tellenc_workspace_t& ws, uint32_t cp)
+{
+    add_language_count(ws, fold_case(cp), 1);
+}
+
+/**
+ * Counts a non-ASCII UTF-8 character, and whether it belongs to a UTF-8
+ * sequence that was decoded as Windows-1252 and encoded again, like "Ã©"
+ * for "é": a lead byte of C2-F4 and its trail bytes of 80-BF, which must
+ * follow without other characters in between.
+ */
+inline void count_utf8_char(tellenc_workspace_t& ws, uint32_t cp,
+                            tellenc_count_t start, tellenc_count_t end)
+{
+    int byte = windows_1252_byte_of(cp);
+    ws.utf8_char_cnt++;
+    count_code_point(ws, cp);
+    if (ws.utf8_double_need > 0 && start == ws.utf8_char_end &&
+            byte >= 0x80 && byte < 0xc0) {
+        ws.utf8_double_run++;
+        if (--ws.utf8_double_need == 0) {
+            ws.utf8_double_cnt += ws.utf8_double_run;
+        }
+    } else if (byte >= 0xc2 && byte <= 0xf4) {
+        ws.utf8_double_need = byte >= 0xf0 ? 3 : byte >= 0xe0 ? 2 : 1;
+        ws.utf8_double_run = 1;
+    } else {
+        ws.utf8_double_need = 0;
+    }
+    ws.utf8_char_end = end;
+}
+
+/**
+ * Counts an invalid UTF-8 sequence from \a offset to \a end; one right
+ * after another is taken as part of it.  The check stops when the errors
+ * are many and outnumber half the characters, as the text cannot be
+ * UTF-8 then.
+ */
+inline void count_utf8_error(tellenc_workspace_t& ws,
+                             tellenc_count_t offset, tellenc_count_t end)
+{
+    if (ws.utf8_errors != 0 && offset == ws.utf8_error_end) {
+        ws.utf8_error_end = end;
+        return;
+    }
+    ws.utf8_error_end = end;
+    if (ws.utf8_errors < MAX_UTF8_ERROR_OFFSETS) {
+        ws.utf8_error_offsets[ws.utf8_errors] = offset;
+    }
+    ws.utf8_errors++;
+    ws.utf8_double_need = 0;
+    ws.is_valid_utf8 = false;
+    if (ws.utf8_errors >= MIN_UTF8_ERRORS_TO_STOP &&
+            ws.utf8_errors > ws.utf8_char_cnt / 2) {
+        ws.is_mostly_utf8 = false;
+    }
+}
+
+/** Gets the share of invalid sequences among the non-ASCII ones. */
+inline double utf8_error_rate(const tellenc_workspace_t& ws)
+{
+    if (ws.utf8_errors == 0) {
+        return 0;
+    }
+    return double(ws.utf8_errors) / (ws.utf8_errors + ws.utf8_char_cnt);
+}
+
+/** Checks whether the text is UTF-8, maybe with a few invalid bytes. */
+inline bool is_utf8_text(const tellenc_workspace_t& ws)
+{
+    return ws.is_valid_utf8 ||
+           (ws.is_mostly_utf8 &&
+            utf8_error_rate(ws) < ws.max_utf8_error_rate);
+}
+
+inline bool is_latin_letter(unsigned char ch)
+{
+    return ch == ' ' || ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'z');
+}
+
+inline void count_utf16_unit(tellenc_workspace_t& ws, int order,
+                             unsigned char unit_class)
+{
+    ws.utf16_class_cnt[order][unit_class]++;
+
+    // A low surrogate must follow a high surrogate, and nothing else may
+    bool in_pair = ws.utf16_in_pair[order];
+    ws.utf16_surrogate_errors[order] +=
+        in_pair != (unit_class == UTF16_LOW_SURROGATE);
+    ws.utf16_in_pair[order] = unit_class == UTF16_HIGH_SURROGATE;
+}
+
+inline bool is_valid_ucs4(uint32_t cp)
+{
+    return cp <= 0x10ffff && (cp & 0xfffff800) != 0xd800;
+}
+
+/** Checks for a printable character of planes 0-2, or a tab or newline. */
+inline bool is_printable_ucs4(uint32_t cp)
+{
+    return (cp >= 0x20 && cp < 0x7f) || (cp >= 0xa0 && cp < 0x30000) ||
+           cp == '\t' || cp == '\n' || cp == '\r';
+}
+
+/**
+ * Checks a UCS-4 code unit in both byte orders.
+ *
+ * @return  \c false if neither byte order is valid any longer
+ */
+inline bool count_ucs4_unit(tellenc_workspace_t& ws, uint32_t word)
+{
+    uint32_t units[2];
+    units[UCS4_BE] = word;
+    units[UCS4_LE] = (word >> 24) | ((word >> 8) & 0xff00) |
+                     ((word << 8) & 0xff0000) | (word << 24);
+    for (int order = UCS4_BE; order <= UCS4_LE; ++order) {
+        ws.ucs4_valid[order] = ws.ucs4_valid[order] &&
+                               is_valid_ucs4(units[order]);
+        ws.ucs4_printable_cnt[order] += is_printable_ucs4(units[order]);
+    }
+    return ws.ucs4_valid[UCS4_BE] || ws.ucs4_valid[UCS4_LE];
+}
+
+/** Checks whether the text is valid UCS-4 in a byte order, and printable. */
+inline bool is_ucs4_text(const tellenc_workspace_t& ws, int order)
+{
+    tellenc_count_t units = ws.pos / 4;
+    return units != 0 && ws.ucs4_valid[order] &&
+           ws.ucs4_printable_cnt[order] * 100 >= units * MIN_UCS4_PRINTABLE;
+}
+
+/**
+ * Scores a single-byte encoding by the weights of the high bytes, and the
+ * counts of its frequent letter pairs.
+ */
+template <size_t N>
+inline double score_sbyte_model(const tellenc_workspace_t& ws,
+                                const signed char* weights,
+                                const uint16_t (&bigrams)[N])
+{
+    // A plain dot product, which compilers can vectorize
+    const tellenc_count_t* cnt = ws.sbyte_char_cnt + 0x80;
+    double score = 0;
+    for (size_t i = 0; i < 0x80; ++i) {
+        score += double(cnt[i]) * weights[i];
+    }
+    tellenc_count_t bigram_cnt = 0;
+    for (size_t i = 0; i < N; ++i) {
+        bigram_cnt += ws.dbyte_char_cnt[bigrams[i] - MAX_DBYTE];
+    }
+    return score + ldexp(double(bigram_cnt), ws.dbyte_scale) *
+                   SBYTE_BIGRAM_WEIGHT;
+}
+
+template <typename Policy>
+inline void scan(tellenc_workspace_t& ws,
+                 const unsigned char* const buffer,
+                 const size_t len)
+{
+    // Constants after inlining, so that the unneeded checks disappear
+    const bool check_nul = is_wanted_utf16_32<Policy>(ws);
+    const bool check_utf16 = is_enabled<Policy>(ws, TELLENC_UTF_16) ||
+                             is_enabled<Policy>(ws, TELLENC_UTF_16LE);
+    bool check_ucs4 = (is_enabled<Policy>(ws, TELLENC_UCS_4) ||
+                       is_enabled<Policy>(ws, TELLENC_UCS_4LE)) &&
+                      (ws.ucs4_valid[UCS4_BE] || ws.ucs4_valid[UCS4_LE]);
+    bool check_escapes = is_wanted_escapes<Policy>(ws) && ws.is_7bit;
+    bool is_shifted = ws.esc_state != ESC_NONE ||
+                      ws.esc_mode != ESC_MODE_ASCII;
+    const bool check_utf8 = is_enabled<Policy>(ws, TELLENC_UTF_8);
+    const bool check_latin1 = is_enabled<Policy>(ws, TELLENC_LATIN1);
+    const bool count_dbyte_chars = is_wanted_freq_tables<Policy>(ws);
+    const bool check_gb18030 = is_enabled<Policy>(ws, TELLENC_GB18030);
+    const bool check_dbcs = count_dbyte_chars || check_utf16 ||
+                            ws.sniff_declared;
+
+    unsigned char ch;
+    unsigned char prev_ch = ws.prev_ch;
+    bool is_line_start = ws.is_line_start;
+    int last_ch = ws.last_ch;
+    int gb4_state = ws.gb4_state;
+    int utf8_state = ws.utf8_state;
+    uint32_t utf8_cp = ws.utf8_cp;
+    uint32_t ucs4_word = ws.ucs4_word;
+    unsigned char dbcs_valid = ws.dbcs_valid;
+    unsigned char dbcs_pending = ws.dbcs_pending;
+    unsigned char dbcs_pending2 = ws.dbcs_pending2;
+    tellenc_count_t pos = ws.pos;
+    for (size_t i = 0; i < len; ++i, ++pos) {
+        ch = buffer[i];
+        ws.sbyte_char_cnt[ch]++;
+
+        // Check for binary data (including UTF-16/32); a DOS EOF is
+        // allowed at the end, which is only known in finish
+        if (is_non_text(ch)) {
+            if (!ws.is_binary && ch != DOS_EOF) {
+                ws.is_binary = true;
+            }
+            if (check_nul && ch == NUL) {
+                // Count for NULs in even- and odd-number bytes
+                ws.nul_count_byte[pos & 1]++;
+                if (pos & 1) {
+                    if (prev_ch == NUL) {
+                        // Count for NULs in even- and odd-number words
+                        ws.nul_count_word[(pos / 2) & 1]++;
+                    }
+                }
+            }
+        }
+
+        // Classify the UTF-16 code unit ending here, in both byte orders,
+        // by table lookups only
+        if (check_utf16 && (pos & 1)) {
+            count_utf16_unit(ws, UTF16_BE, utf16_class_table[prev_ch]);
+            count_utf16_unit(ws, UTF16_LE, utf16_class_table[ch]);
+            if (is_latin_letter(prev_ch) && is_latin_letter(ch)) {
+                ws.utf16_latin_cnt++;
+            }
+        }
+
+        // Line endings and indentation, which only need the CRLFs and
+        // the first characters of lines counted
+        if (ch == '\n' || ch == '\r') {
+            if (ch == '\n' && prev_ch == '\r') {
+                ws.crlf_cnt++;
+            }
+            is_line_start = true;
+            ws.eol_end = pos + 1;
+        } else if (is_line_start) {
+            if (ch == '\t') {
+                ws.tab_indent_cnt++;
+            } else if (ch == ' ') {
+                ws.space_indent_cnt++;
+            }
+            is_line_start = false;
+        }
+        prev_ch = ch;
+
+        // Check the UCS-4 code unit ending here, until the text cannot be
+        // UCS-4 in either byte order, which for other text is at once
+        if (check_ucs4) {
+            ucs4_word = (ucs4_word << 8) | ch;
+            if ((pos & 3) == 3) {
+                check_ucs4 = count_ucs4_unit(ws, ucs4_word);
+            }
+        }
+
+        // Only the bytes flagged by the table, or in a shifted state, need
+        // checks for escape sequences
+        if (check_escapes && (escape_char_table[ch] || is_shifted)) {
+            check_escapes = scan_escape(ws, ch);
+            is_shifted = ws.esc_state != ESC_NONE ||
+                         ws.esc_mode != ESC_MODE_ASCII;
+        }
+        // Check for UTF-8 validity.  After an invalid sequence the check
+        // goes on from the next byte, so that a few corrupt bytes can be
+        // told from a text in another encoding.
+        if (check_utf8 && ws.is_mostly_utf8) {
+            int type = utf8_char_table[ch];
+            if (type == UTF8_TAIL) {
+                if (utf8_state > UTF8_1) {
+                    utf8_cp = (utf8_cp << 6) | (ch & 0x3f);
+                    if (--utf8_state == UTF8_1) {
+                        count_utf8_char(ws, utf8_cp, ws.utf8_char_start,
+                                        pos + 1);
+                    }
+                } else {
+                    count_utf8_error(ws, pos, pos + 1);
+                }
+            } else {
+                if (utf8_state != UTF8_1) {
+                    // The last sequence is cut short
+                    count_utf8_error(ws, ws.utf8_char_start, pos);
+                    utf8_state = UTF8_1;
+                }
+                if (type == UTF8_INVALID) {
+                    count_utf8_error(ws, pos, pos + 1);
+                } else if (type != UTF8_1) {
+                    // The lead byte keeps 7 - type bits: 5, 4 or 3
+                    utf8_state = type;
+                    utf8_cp = ch & (0x7f >> type);
+                    ws.utf8_char_start = pos;
+                }
+            }
+        }
+
+        // Check whether non-Latin1 characters appear
+        if (check_latin1 && ws.is_valid_latin1) {
+            if (ch >= 0x80 && ch < 0xa0) {
+                ws.is_valid_latin1 = false;
+            }
+        }
+
+        // Check the lead and trail bytes of the double-byte families at
+        // once, as bits
+        if (check_dbcs && dbcs_valid != 0 &&
+                (ch >= 0x80 || dbcs_pending != 0)) {
+            const dbcs_class_info& info = dbcs_classes[dbcs_class_table[ch]];
+            unsigned char fresh = dbcs_valid & ~dbcs_pending;
+            dbcs_valid &= (dbcs_pending & info.trail) | (fresh & info.start);
+            dbcs_pending = ((fresh & info.lead) |
+                            (dbcs_pending & dbcs_pending2)) & dbcs_valid;
+            dbcs_pending2 = fresh & info.lead3;
+        }
+
+        // Construct double-bytes and count.  A high byte and a digit may
+        // start a four-byte sequence of GB18030 instead, which are only
+        // counted as double-bytes if the sequence turns out broken.
+        if (gb4_state == GB4_DIGIT) {
+            if (ch >= 0x81 && ch <= 0xfe) {
+                ws.gb4_bytes[2] = ch;
+                gb4_state = GB4_THIRD;
+            } else {
+                gb4_state = GB4_NONE;
+                count_broken_gb4(ws, count_dbyte_chars);
+                if (ch >= 0x80) {
+                    last_ch = ch;
+                }
+            }
+        } else if (gb4_state == GB4_THIRD) {
+            gb4_state = GB4_NONE;
+            if (ch >= 0x30 && ch <= 0x39) {
+                ws.gb18030_cnt++;
+            } else {
+                count_broken_gb4(ws, count_dbyte_chars);
+                count_dbyte(ws, ws.gb4_bytes[2], ch, count_dbyte_chars);
+            }
+        } else if (last_ch != EOF) {
+            if (check_gb18030 && last_ch >= 0x81 && last_ch <= 0xfe &&
+                    ch >= 0x30 && ch <= 0x39) {
+                ws.gb4_bytes[0] = (unsigned char)last_ch;
+                ws.gb4_bytes[1] = ch;
+                gb4_state = GB4_DIGIT;
+            } else {
+                count_dbyte(ws, last_ch, ch, count_dbyte_chars);
+            }
+            last_ch = EOF;
+        } else if (ch >= 0x80) {
+            last_ch = ch;
+        }
+    }
+
+    ws.prev_ch = prev_ch;
+    ws.is_line_start = is_line_start;
+    ws.last_ch = last_ch;
+    ws.gb4_state = gb4_state;
+    ws.utf8_state = utf8_state;
+    ws.utf8_cp = utf8_cp;
+    ws.ucs4_word = ucs4_word;
+    ws.dbcs_valid = dbcs_valid;
+    ws.dbcs_pending = dbcs_pending;
+    ws.dbcs_pending2 = dbcs_pending2;
+    ws.pos = pos;
+}
+
+inline tellenc_encoding_t detect_bom(const tellenc_workspace_t& ws)
+{
+    return check_ucs_bom(ws.head, ws.head_len);
+}
+
+/** Recognizes common binary formats by their magic numbers. */
+inline tellenc_encoding_t detect_magic(const tellenc_workspace_t& ws)
+{
+    const struct pattern_t {
+        const char* pattern;
+        size_t pattern_len;
+    } patterns[] = {
+        { "\x89PNG",            4 },
+        { "\xFF\xD8\xFF",       3 },    // JPEG
+        { "%PDF",               4 },
+        { "PK\x03\x04",         4 },    // ZIP
+        { "\x1F\x8B",           2 },    // gzip
+        { "\x7F" "ELF",         4 },
+        { NULL,                 0 }
+    };
+    for (size_t i = 0; patterns[i].pattern; ++i) {
+        const pattern_t& item = patterns[i];
+        if (ws.head_len >= item.pattern_len &&
+            memcmp(ws.head, item.pattern, item.pattern_len) == 0) {
+            return TELLENC_BINARY;
+        }
+    }
+    return TELLENC_UNKNOWN;
+}
+
+template <typename Policy>
+inline tellenc_encoding_t detect_utf16_32(const tellenc_workspace_t& ws)
+{
+    if (ws.is_valid_utf8 || !ws.is_binary) {
+        return TELLENC_UNKNOWN;
+    }
+
+    // Heuristics for UTF-16/32; UCS-4 must also be valid and printable
+    const tellenc_count_t* nul_count_byte = ws.nul_count_byte;
+    const tellenc_count_t* nul_count_word = ws.nul_count_word;
+    if        (is_enabled<Policy>(ws, TELLENC_UTF_16) &&
+               nul_count_byte[EVEN] > 4 &&
+               (nul_count_byte[ODD] == 0 ||
+                nul_count_byte[EVEN] / nul_count_byte[ODD] > 20)) {
+        return TELLENC_UTF_16;
+    } else if (is_enabled<Policy>(ws, TELLENC_UTF_16LE) &&
+               nul_count_byte[ODD] > 4 &&
+               (nul_count_byte[EVEN] == 0 ||
+                nul_count_byte[ODD] / nul_count_byte[EVEN] > 20)) {
+        return TELLENC_UTF_16LE;
+    } else if (is_enabled<Policy>(ws, TELLENC_UCS_4) &&
+               nul_count_word[EVEN] > 4 &&
+               (nul_count_word[ODD] == 0 ||
+                nul_count_word[EVEN] / nul_count_word[ODD] > 20) &&
+               is_ucs4_text(ws, UCS4_BE)) {
+        return TELLENC_UCS_4;   // utf-32 is not a built-in encoding for Vim
+    } else if (is_enabled<Policy>(ws, TELLENC_UCS_4LE) &&
+               nul_count_word[ODD] > 4 &&
+               (nul_count_word[EVEN] == 0 ||
+                nul_count_word[ODD] / nul_count_word[EVEN] > 20) &&
+               is_ucs4_text(ws, UCS4_LE)) {
+        return TELLENC_UCS_4LE; // utf-32le is not a built-in encoding for Vim
+    }
+    return TELLENC_UNKNOWN;
+}
+
+/**
+ * Gets the percentage of UTF-16 code units in one byte order that are
+ * likely in CJK text; 0 if the surrogates are not paired, or if CJK
+ * characters are not the majority.
+ */
+inline uint32_t utf16_confidence(const tellenc_workspace_t& ws, int order)
+{
+    const tellenc_count_t* cnt = ws.utf16_class_cnt[order];
+    tellenc_count_t units = ws.pos / 2;
+    if (ws.utf16_surrogate_errors[order] != 0 ||
+            cnt[UTF16_CJK] * 2 < units) {
+        return 0;
+    }
+    return uint32_t((cnt[UTF16_BASIC] + cnt[UTF16_CJK] +
+                     cnt[UTF16_HIGH_SURROGATE] + cnt[UTF16_LOW_SURROGATE]) *
+                    100 / units);
+}
+
+/**
+ * Checks whether the lead and trail bytes of the text fit a double-byte
+ * family; in GBK, a digit after a lead byte must start a four-byte
+ * sequence of GB18030.
+ */
+inline bool fits_dbcs(const tellenc_workspace_t& ws, int family)
+{
+    if (family == DBCS_GBK && ws.gb18030_errors != 0) {
+        return false;
+    }
+    return (ws.dbcs_valid & (1 << family)) != 0;
+}
+
+/** Gets the double-byte family of an encoding, or -1 if none. */
+inline int dbcs_family_of(tellenc_encoding_t enc)
+{
+    switch (enc) {
+    case TELLENC_SJIS:
+        return DBCS_SJIS;
+    case TELLENC_EUC_JP:
+        return DBCS_EUC_JP;
+    case TELLENC_EUC_KR:
+        return DBCS_EUC;
+    case TELLENC_GB2312:    // Taken as GBK, like browsers do
+    case TELLENC_GBK:
+    case TELLENC_GB18030:
+        return DBCS_GBK;
+    case TELLENC_BIG5:
+        return DBCS_BIG5;
+    default:
+        return -1;
+    }
+}
+
+/** Checks whether the text fits any double-byte family. */
+inline bool fits_any_dbcs(const tellenc_workspace_t& ws)
+{
+    for (int family = 0; family < DBCS_FAMILY_COUNT; ++family) {
+        if (fits_dbcs(ws, family)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Finds UTF-16 CJK text by its code units, which need not have NULs.
+ * Legacy double-byte text read as UTF-16 is mostly CJK too, so text whose
+ * bytes pair up as lead and trail bytes of such an encoding is left to
+ * the frequency tables.
+ */
+template <typename Policy>
+inline tellenc_encoding_t detect_utf16_text(const tellenc_workspace_t& ws)
+{
+    // Western text read as UTF-16 is mostly CJK too, but in letters
+    tellenc_count_t units = ws.pos / 2;
+    if (ws.pos % 2 != 0 || units < MIN_UTF16_UNITS || ws.is_valid_utf8 ||
+            ws.utf16_latin_cnt * 3 >= units || fits_any_dbcs(ws)) {
+        return TELLENC_UNKNOWN;
+    }
+
+    uint32_t be_confidence = utf16_confidence(ws, UTF16_BE);
+    uint32_t le_confidence = utf16_confidence(ws, UTF16_LE);
+    if (ws.verbose) {
+        printf("UTF-16 confidence: %u%% (big-endian), %u%% (little-endian)\n",
+               be_confidence, le_confidence);
+    }
+    if (is_enabled<Policy>(ws, TELLENC_UTF_16) &&
+            be_confidence >= MIN_UTF16_CONFIDENCE &&
+            be_confidence >= le_confidence) {
+        return TELLENC_UTF_16;
+    } else if (is_enabled<Policy>(ws, TELLENC_UTF_16LE) &&
+               le_confidence >= MIN_UTF16_CONFIDENCE) {
+        return TELLENC_UTF_16LE;
+    }
+    return TELLENC_UNKNOWN;
+}
+
+inline tellenc_encoding_t detect_binary(const tellenc_workspace_t& ws)
+{
+    if (!ws.is_valid_utf8 && ws.is_binary) {
+        return TELLENC_BINARY;
+    }
+    return TELLENC_UNKNOWN;
+}
+
+/** Finds the 7-bit encodings whose escape sequences or shifts are valid. */
+template <typename Policy>
+inline tellenc_encoding_t detect_escapes(const tellenc_workspace_t& ws)
+{
+    static const struct kind_t {
+        unsigned char       kind;
+        tellenc_encoding_t  enc;
+    } kinds[] = {
+        { ESC_ISO_2022_KR,   TELLENC_ISO_2022_KR },
+        { ESC_ISO_2022_CN,   TELLENC_ISO_2022_CN },
+        { ESC_ISO_2022_JP_2, TELLENC_ISO_2022_JP_2 },
+        { ESC_ISO_2022_JP,   TELLENC_ISO_2022_JP },
+        { ESC_HZ,            TELLENC_HZ },
+        { ESC_UTF_7,         TELLENC_UTF_7 },
+    };
+    if (!ws.is_7bit) {
+        return TELLENC_UNKNOWN;
+    }
+    for (size_t i = 0; i < sizeof kinds / sizeof kinds[0]; ++i) {
+        tellenc_count_t errors = ws.iso2022_errors;
+        if (kinds[i].kind == ESC_HZ) {
+            errors = ws.hz_errors;
+        } else if (kinds[i].kind == ESC_UTF_7) {
+            errors = ws.utf7_errors;
+        }
+        if (is_enabled<Policy>(ws, kinds[i].enc) &&
+                ws.esc_cnt[kinds[i].kind] != 0 && errors == 0) {
+            return kinds[i].enc;
+        }
+    }
+    return TELLENC_UNKNOWN;
+}
+
+inline tellenc_encoding_t detect_ascii(const tellenc_workspace_t& ws)
+{
+    // No characters outside the scope of ASCII
+    return ws.dbyte_cnt == 0 ? TELLENC_ASCII : TELLENC_UNKNOWN;
+}
+
+inline tellenc_encoding_t detect_utf8(const tellenc_workspace_t& ws)
+{
+    // Only valid UTF-8 sequences
+    return ws.is_valid_utf8 ? TELLENC_UTF_8 : TELLENC_UNKNOWN;
+}
+
+inline tellenc_encoding_t detect_mostly_utf8(const tellenc_workspace_t& ws)
+{
+    // UTF-8 with invalid sequences below max_utf8_error_rate
+    return is_utf8_text(ws) ? TELLENC_UTF_8 : TELLENC_UNKNOWN;
+}
+
+/**
+ * Trusts a declared charset unless the checks of the scan refute it: a
+ * declared UTF-8 must be valid (but for a few errors), other declared
+ * encodings, which must be ASCII-compatible, must not be UTF-8, and the
+ * text must fit the lead and trail bytes of a declared double-byte
+ * encoding.  So the histograms need not be looked at.
+ */
+template <typename Policy>
+inline tellenc_encoding_t detect_declared(const tellenc_workspace_t& ws)
+{
+    tellenc_encoding_t enc = ws.declared_enc;
+    if (enc == TELLENC_UNKNOWN || enc == TELLENC_ASCII ||
+            encoding_info[enc].byte_width != 1 ||
+            !encoding_info[enc].ascii_compatible) {
+        return TELLENC_UNKNOWN;
+    }
+    if (enc == TELLENC_UTF_8) {
+        return is_utf8_text(ws) ? enc : TELLENC_UNKNOWN;
+    }
+    if (is_utf8_text(ws)) {
+        return TELLENC_UNKNOWN;
+    }
+    int family = dbcs_family_of(enc);
+    if (family >= 0 && !fits_dbcs(ws, family)) {
+        return TELLENC_UNKNOWN;
+    }
+
+    // Like browsers, take Latin1 as Windows-1252 and GB2312 as GBK; they
+    // are reported as the subsets again if the text fits
+    if (enc == TELLENC_LATIN1) {
+        enc = TELLENC_WINDOWS_1252;
+    } else if (enc == TELLENC_GB2312 || enc == TELLENC_GBK) {
+        enc = ws.gb18030_cnt > ws.gb18030_errors &&
+              is_enabled<Policy>(ws, TELLENC_GB18030) ? TELLENC_GB18030
+                                                      : TELLENC_GBK;
+    }
+    return is_wanted<Policy>(ws, enc) ? enc : TELLENC_UNKNOWN;
+}
+
+/** Finds GB18030 by its four-byte sequences, valid in no other encoding. */
+template <typename Policy>
+inline tellenc_encoding_t detect_gb18030(const tellenc_workspace_t& ws)
+{
+    if (is_enabled<Policy>(ws, TELLENC_GB18030) &&
+            ws.gb18030_cnt > ws.gb18030_errors) {
+        return TELLENC_GB18030;
+    }
+    return TELLENC_UNKNOWN;
+}
+
+/**
+ * Finds the single-byte encoding whose letters fit the high bytes best,
+ * if they are a good part of the letters.
+ */
+template <typename Policy>
+inline tellenc_encoding_t detect_sbyte_models(const tellenc_workspace_t& ws)
+{
+    if (!is_wanted_sbyte_models<Policy>(ws)) {
+        return TELLENC_UNKNOWN;
+    }
+    tellenc_count_t high_cnt = 0;
+    for (size_t i = 0x80; i < MAX_CHAR; ++i) {
+        high_cnt += ws.sbyte_char_cnt[i];
+    }
+    tellenc_count_t letter_cnt = high_cnt;
+    for (unsigned char ch = 'A'; ch <= 'Z'; ++ch) {
+        letter_cnt += ws.sbyte_char_cnt[ch] + ws.sbyte_char_cnt[ch | 0x20];
+    }
+    if (high_cnt == 0 || high_cnt * 10 < letter_cnt * 3) {
+        return TELLENC_UNKNOWN;
+    }
+
+    tellenc_encoding_t best_enc = TELLENC_UNKNOWN;
+    double best_score = MIN_SBYTE_SCORE * high_cnt;
+#define TELLENC_SCORE_SBYTE_MODEL(enc, model)                            \
+    if (is_enabled<Policy>(ws, enc)) {                                  \
+        double score = score_sbyte_model(ws, sbyte_weights_##model,      \
+                                         sbyte_bigrams_##model) *        \
+                       ws.priors[enc];                                  \
+        if (ws.verbose) {                                               \
+            printf("Score of %s: %.1f\n", encoding_info[enc].name,      \
+                   score / high_cnt);                                   \
+        }                                                               \
+        if (score > best_score) {                                       \
+            best_enc = enc;                                             \
+            best_score = score;                                         \
+        }                                                               \
+    }
+    TELLENC_SBYTE_MODELS(TELLENC_SCORE_SBYTE_MODEL)
+#undef TELLENC_SCORE_SBYTE_MODEL
+    return best_enc;
+}
+
+/**
+ * Gets the share of \a enc in its score of the single-byte models and
+ * that of the runner-up.
+ */
+template <typename Policy>
+inline double sbyte_model_share(const tellenc_workspace_t& ws,
+                                tellenc_encoding_t enc)
+{
+    double own_score = 0;
+    double other_score = 0;
+#define TELLENC_SHARE_SBYTE_MODEL(model_enc, model)                      \
+    if (is_enabled<Policy>(ws, model_enc)) {                            \
+        double score = score_sbyte_model(ws, sbyte_weights_##model,      \
+                                         sbyte_bigrams_##model) *        \
+                       ws.priors[model_enc];                            \
+        if (model_enc == enc) {                                         \
+            own_score = score;                                          \
+        } else if (score > other_score) {                               \
+            other_score = score;                                        \
+        }                                                               \
+    }
+    TELLENC_SBYTE_MODELS(TELLENC_SHARE_SBYTE_MODEL)
+#undef TELLENC_SHARE_SBYTE_MODEL
+    return own_score > 0 ? own_score / (own_score + other_score) : 0;
+}
+
+template <typename Policy>
+inline tellenc_encoding_t detect_freq(const tellenc_workspace_t& ws)
+{
+    return search_freq_dbytes<Policy>(ws);
+}
+
+template <typename Policy>
+inline tellenc_encoding_t detect_single_byte(const tellenc_workspace_t& ws)
+{
+    if (is_wanted<Policy>(ws, TELLENC_WINDOWS_1252) && ws.dbyte_cnt != 0 &&
+            ws.dbyte_hihi_cnt * 100 / ws.dbyte_cnt < 5) {
+        // Mostly a low-byte follows a high-byte
+        return TELLENC_WINDOWS_1252;
+    }
+    return TELLENC_UNKNOWN;
+}
+
+/** The built-in detectors, in the order of cost. */
+template <typename Policy>
+inline const tellenc_detector_t* builtin_detectors(size_t& count)
+{
+    static const tellenc_detector_t detectors[] = {
+        { "bom",         1,    TELLENC_EVIDENCE_HEAD,   detect_bom },
+        { "magic",       2,    TELLENC_EVIDENCE_HEAD,   detect_magic },
+        { "utf-16/32",   10,   TELLENC_EVIDENCE_COUNTS,
+                                                    detect_utf16_32<Policy> },
+        { "utf-16 text", 10,   TELLENC_EVIDENCE_COUNTS,
+                                                  detect_utf16_text<Policy> },
+        { "binary",      10,   TELLENC_EVIDENCE_COUNTS, detect_binary },
+        { "escape",      10,   TELLENC_EVIDENCE_COUNTS,
+                                                    detect_escapes<Policy> },
+        { "ascii",       10,   TELLENC_EVIDENCE_COUNTS, detect_ascii },
+        { "declared",    10,   TELLENC_EVIDENCE_COUNTS,
+                                                   detect_declared<Policy> },
+        { "utf-8",       10,   TELLENC_EVIDENCE_COUNTS, detect_utf8 },
+        { "mostly utf-8", 10,  TELLENC_EVIDENCE_COUNTS, detect_mostly_utf8 },
+        { "gb18030",     20,   TELLENC_EVIDENCE_COUNTS,
+                                                    detect_gb18030<Policy> },
+        { "letters",     50,   TELLENC_EVIDENCE_COUNTS,
+                                               detect_sbyte_models<Policy> },
+        { "frequency",   100,  TELLENC_EVIDENCE_COUNTS |
+                               TELLENC_EVIDENCE_DBYTE_RANK,
+                                                        detect_freq<Policy> },
+        // Only a guess, so it comes after everything else
+        { "single-byte", 1000, TELLENC_EVIDENCE_COUNTS,
+                                                 detect_single_byte<Policy> },
+    };
+    count = sizeof detectors / sizeof detectors[0];
+    return detectors;
+}
+
+/** Gets the double-bytes in descending order of counts. */
+inline void rank_dbytes(tellenc_workspace_t& ws, bool all)
+{
+    uint16_t* dbyte_chars_end = ws.dbyte_chars + ws.dbyte_uniq_cnt;
+    if (all) {
+        std::sort(ws.dbyte_chars, dbyte_chars_end,
+                  greater_dbyte_count(ws.dbyte_char_cnt));
+    } else {
+        std::partial_sort(ws.dbyte_chars,
+                          ws.dbyte_chars + std::min(ws.dbyte_uniq_cnt,
+                                                    (uint32_t)MAX_COMP_IDX),
+                          dbyte_chars_end,
+                          greater_dbyte_count(ws.dbyte_char_cnt));
+    }
+}
+
+/**
+ * Runs the built-in and added detectors, cheapest first, that need only
+ * the evidence in \a available, but not only that in \a done (for which
+ * they have already run).
+ */
+template <typename Policy>
+inline tellenc_encoding_t run_detectors(tellenc_workspace_t& ws,
+                                        unsigned available,
+                                        unsigned done)
+{
+    size_t builtin_count;
+    const tellenc_detector_t* builtins =
+        builtin_detectors<Policy>(builtin_count);
+    bool is_ranked = ws.verbose;    // fully sorted already
+    size_t i = 0;
+    size_t j = 0;
+    while (i < builtin_count || j < ws.detector_count) {
+        const tellenc_detector_t* detector;
+        if (j == ws.detector_count ||
+                (i < builtin_count &&
+                 builtins[i].cost <= ws.detectors[j]->cost)) {
+            detector = &builtins[i++];
+        } else {
+            detector = ws.detectors[j++];
+        }
+        if ((detector->evidence & ~available) != 0 ||
+                (detector->evidence & ~done) == 0) {
+            continue;
+        }
+        if ((detector->evidence & TELLENC_EVIDENCE_DBYTE_RANK) &&
+                !is_ranked) {
+            rank_dbytes(ws, false);
+            is_ranked = true;
+        }
+        // An encoding that is not a candidate leaves it to the others
+        tellenc_encoding_t enc = detector->detect(ws);
+        if (enc != TELLENC_UNKNOWN &&
+                (enc == TELLENC_BINARY || enc == TELLENC_ASCII ||
+                 is_wanted<Policy>(ws, enc))) {
+            if (ws.verbose) {
+                printf("Decided by the %s detector\n", detector->name);
+            }
+            ws.decided_by = detector;
+            return enc;
+        }
+    }
+    return TELLENC_UNKNOWN;
+}
+
+/**
+ * Gets how sure the detection of \a enc is, from 0 to 1: 1 when the
+ * structure of the text tells it; the share of valid UTF-8 sequences for
+ * text mostly in UTF-8; the share of the score of \a enc against the
+ * runner-up for the statistical detectors; and 0 if unknown.  It is
+ * halved when the scan stopped early, as the rest of the text is unseen.
+ */
+template <typename Policy>
+inline double detection_confidence(const tellenc_workspace_t& ws,
+                                   tellenc_encoding_t enc)
+{
+    if (enc == TELLENC_UNKNOWN) {
+        return 0;
+    }
+    double confidence = 1;
+    tellenc_encoding_t (*detect)(const tellenc_workspace_t&) =
+        ws.decided_by ? ws.decided_by->detect : NULL;
+    if (detect == detect_mostly_utf8) {
+        confidence = 1 - utf8_error_rate(ws);
+    } else if (detect == detect_sbyte_models<Policy>) {
+        confidence = sbyte_model_share<Policy>(ws, enc);
+    } else if (detect == detect_freq<Policy>) {
+        confidence = freq_dbyte_share<Policy>(ws, enc);
+    } else if (detect == detect_single_byte<Policy>) {
+        // Only a guess, however few the high bytes before high bytes
+        confidence = 0.5 * (1 - double(ws.dbyte_hihi_cnt) / ws.dbyte_cnt);
+    }
+    if (ws.sole_enc != TELLENC_UNKNOWN) {
+        confidence /= 2;
+    }
+    return confidence;
+}
+
+/** Checks whether the text scanned so far may be in an encoding. */
+inline bool is_consistent(const tellenc_workspace_t& ws,
+                          tellenc_encoding_t enc, bool has_high_bytes)
+{
+    switch (enc) {
+    case TELLENC_ASCII:
+        return !has_high_bytes && !ws.is_binary;
+    case TELLENC_UTF_8:
+        return ws.is_valid_utf8 || (ws.is_mostly_utf8 && !ws.is_binary);
+    case TELLENC_UTF_16:
+    case TELLENC_UTF_16LE:
+        return true;
+    case TELLENC_UCS_4:
+        return ws.ucs4_valid[UCS4_BE];
+    case TELLENC_UCS_4LE:
+        return ws.ucs4_valid[UCS4_LE];
+    case TELLENC_LATIN1:
+        return ws.is_valid_latin1 && !ws.is_binary;
+    case TELLENC_ISO_2022_JP:
+    case TELLENC_ISO_2022_JP_2:
+    case TELLENC_ISO_2022_KR:
+    case TELLENC_ISO_2022_CN:
+    case TELLENC_HZ:
+    case TELLENC_UTF_7:
+        return ws.is_7bit && !ws.is_binary;
+    default:
+        if (ws.is_binary) {
+            return false;
+        }
+        int family = dbcs_family_of(enc);
+        return family < 0 || fits_dbcs(ws, family);
+    }
+}
+
+/**
+ * Gets the only candidate that the text scanned so far may be in, or
+ * TELLENC_UNKNOWN if there are more.
+ */
+template <typename Policy>
+inline tellenc_encoding_t find_sole_candidate(const tellenc_workspace_t& ws)
+{
+    bool has_high_bytes = false;
+    for (size_t ch = 0x80; ch < MAX_CHAR && !has_high_bytes; ++ch) {
+        has_high_bytes = ws.sbyte_char_cnt[ch] != 0;
+    }
+    tellenc_encoding_t sole_enc = TELLENC_UNKNOWN;
+    for (int i = TELLENC_ASCII; i < TELLENC_ENCODING_COUNT; ++i) {
+        tellenc_encoding_t enc = tellenc_encoding_t(i);
+        if (!is_enabled<Policy>(ws, enc) ||
+                !is_consistent(ws, enc, has_high_bytes)) {
+            continue;
+        }
+        if (sole_enc != TELLENC_UNKNOWN) {
+            return TELLENC_UNKNOWN;
+        }
+        sole_enc = enc;
+    }
+    return sole_enc;
+}
+
+template <typename Policy>
+inline bool feed(tellenc_workspace_t& ws,
+                 const unsigned char* const buffer,
+                 const size_t len)
+{
+    if (ws.head_enc != TELLENC_UNKNOWN || ws.sole_enc != TELLENC_UNKNOWN) {
+        return true;
+    }
+
+    // A BOM or magic number decides the encoding without looking at the
+    // rest
+    if (ws.head_len < sizeof ws.head) {
+        size_t copy_len = std::min(sizeof ws.head - ws.head_len, len);
+        memcpy(ws.head + ws.head_len, buffer, copy_len);
+        ws.head_len += copy_len;
+        if (ws.head_len == sizeof ws.head) {
+            ws.head_enc =
+                run_detectors<Policy>(ws, TELLENC_EVIDENCE_HEAD, 0);
+            if (ws.head_enc != TELLENC_UNKNOWN) {
+                ws.pos = ws.head_len;
+                return true;
+            }
+        }
+    }
+
+    // A charset declared in the first bytes is checked in finish
+    if (ws.sniff_declared && ws.decl_len < DECL_SNIFF_BYTES) {
+        size_t copy_len = std::min(DECL_SNIFF_BYTES - ws.decl_len, len);
+        memcpy(ws.decl_buf + ws.decl_len, buffer, copy_len);
+        ws.decl_len += copy_len;
+        if (ws.decl_len == DECL_SNIFF_BYTES) {
+            ws.declared_enc = sniff_declared(ws.decl_buf, ws.decl_len);
+        }
+    }
+
+    // The text is scanned in blocks, before each of which the 32-bit
+    // double-byte counts are checked for room.  With candidates given and
+    // stop_early set, the scan stops when only one of them is left; it is
+    // checked at the same offsets however the text is fed.
+    const bool check_candidates = ws.has_candidates && ws.stop_early;
+    const unsigned char* ptr = buffer;
+    size_t left = len;
+    while (left != 0) {
+        size_t block = std::min(MAX_SCAN_BLOCK, left);
+        if (check_candidates) {
+            block = std::min(CANDIDATE_CHECK_BYTES -
+                                 size_t(ws.pos % CANDIDATE_CHECK_BYTES),
+                             block);
+        }
+        reserve_dbyte_counts(ws, block);
+        scan<Policy>(ws, ptr, block);
+        ptr += block;
+        left -= block;
+        if (check_candidates && ws.pos % CANDIDATE_CHECK_BYTES == 0) {
+            ws.sole_enc = find_sole_candidate<Policy>(ws);
+            if (ws.sole_enc != TELLENC_UNKNOWN) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Gets the letters counted from \a first to \a last; ASCII letters are
+ * counted in both cases, and the others in lowercase.
+ */
+inline tellenc_count_t count_letters(const tellenc_workspace_t& ws,
+                                     uint32_t first, uint32_t last)
+{
+    tellenc_count_t cnt = 0;
+    if (last < 0x80) {
+        for (uint32_t ch = first; ch <= last; ++ch) {
+            cnt += ws.sbyte_char_cnt[ch] + ws.sbyte_char_cnt[ch ^ 0x20];
+        }
+    } else if (last < MAX_LANGUAGE_CP) {
+        for (uint32_t cp = first; cp <= last; ++cp) {
+            cnt += ws.lang_cp_cnt[cp];
+        }
+    } else {
+        for (uint32_t block = first >> 6; block <= last >> 6; ++block) {
+            cnt += ws.lang_block_cnt[block];
+        }
+    }
+    return cnt;
+}
+
+/** Gets the number of letters from \a first to \a last. */
+inline double letters_in(uint32_t first, uint32_t last)
+{
+    return last < 0x80 ? 26 : last - first + 1;
+}
+
+/**
+ * Scores a language by the log-likelihood of the letters, each letter of
+ * a row having the same probability, and those of no row a tiny one.
+ * Returns the next row of language_models.
+ */
+inline size_t score_language(const tellenc_workspace_t& ws, size_t row,
+                             tellenc_count_t total, double& score)
+{
+    const size_t row_count =
+        sizeof language_models / sizeof language_models[0];
+    const language_letters& base = language_models[row];
+    tellenc_count_t base_cnt = count_letters(ws, base.first, base.last);
+    tellenc_count_t counted = 0;
+    uint32_t rest = 10000;
+    score = 0;
+    size_t i = row + 1;
+    for (; i < row_count &&
+           language_models[i].language == base.language; ++i) {
+        const language_letters& letters = language_models[i];
+        tellenc_count_t cnt = count_letters(ws, letters.first,
+                                            letters.last);
+        if (letters.first >= base.first && letters.last <= base.last) {
+            base_cnt -= cnt;
+        }
+        counted += cnt;
+        rest -= letters.per_10000;
+        score += cnt * log(letters.per_10000 / 10000.0 /
+                           letters_in(letters.first, letters.last));
+    }
+    counted += base_cnt;
+    score += base_cnt * log(rest / 10000.0 /
+                            letters_in(base.first, base.last));
+    score += (total - counted) * log(UNMODELED_LETTER_RATE);
+    return i;
+}
+
+/**
+ * Finds the likely language from the letters counted by the scan, the
+ * non-ASCII ones decoded in \a enc; multibyte CJK encodings tell the
+ * language by themselves.
+ */
+inline void identify_language(tellenc_workspace_t& ws, tellenc_encoding_t enc)
+{
+    tellenc_language_t cjk_language = TELLENC_LANG_UNKNOWN;
+    const uint16_t* chars = NULL;
+    switch (enc) {
+    case TELLENC_GB2312:
+    case TELLENC_GBK:
+    case TELLENC_GB18030:
+    case TELLENC_BIG5:
+    case TELLENC_ISO_2022_CN:
+    case TELLENC_HZ:
+        cjk_language = TELLENC_LANG_ZH;
+        break;
+    case TELLENC_SJIS:
+    case TELLENC_EUC_JP:
+    case TELLENC_ISO_2022_JP:
+    case TELLENC_ISO_2022_JP_2:
+        cjk_language = TELLENC_LANG_JA;
+        break;
+    case TELLENC_EUC_KR:
+    case TELLENC_ISO_2022_KR:
+        cjk_language = TELLENC_LANG_KO;
+        break;
+    case TELLENC_ASCII:
+    case TELLENC_UTF_8:
+    case TELLENC_LATIN1:
+    case TELLENC_WINDOWS_1252:
+        break;
+#define TELLENC_SBYTE_CHARS_CASE(enc, name)                     \
+    case enc:                                                   \
+        chars = sbyte_chars_##name;                             \
+        break;
+    TELLENC_SBYTE_CHARSETS(TELLENC_SBYTE_CHARS_CASE)
+#undef TELLENC_SBYTE_CHARS_CASE
+    default:
+        return;
+    }
+    if (cjk_language != TELLENC_LANG_UNKNOWN) {
+        ws.language = cjk_language;
+        ws.language_confidence = 1;
+        return;
+    }
+
+    // Letters of double-encoded text are not what they seem
+    if (enc == TELLENC_UTF_8 && ws.is_valid_utf8 && ws.utf8_char_cnt != 0 &&
+            ws.utf8_double_cnt >=
+                MIN_DOUBLE_ENCODED_RATIO * ws.utf8_char_cnt) {
+        return;
+    }
+
+    // The high bytes of single-byte encodings are decoded now
+    if (enc != TELLENC_ASCII && enc != TELLENC_UTF_8) {
+        clear_language_counts(ws);
+        for (int i = 0; i < 0x80; ++i) {
+            tellenc_count_t cnt = ws.sbyte_char_cnt[0x80 + i];
+            uint32_t cp = chars ? chars[i]
+                        : i < 0x20 ? windows_1252_chars[i] : 0x80 + i;
+            if (cnt != 0 && cp != 0) {
+                add_language_count(ws, fold_case(cp), cnt);
+            }
+        }
+    }
+
+    tellenc_count_t total = count_letters(ws, 'a', 'z');
+    for (size_t i = 0; i < sizeof letter_ranges / sizeof letter_ranges[0];
+            ++i) {
+        total += count_letters(ws, letter_ranges[i][0], letter_ranges[i][1]);
+    }
+    if (total < MIN_LANGUAGE_LETTERS) {
+        return;
+    }
+
+    double scores[TELLENC_LANGUAGE_COUNT];
+    tellenc_language_t best = TELLENC_LANG_UNKNOWN;
+    const size_t row_count =
+        sizeof language_models / sizeof language_models[0];
+    for (size_t row = 0; row < row_count; ) {
+        int language = language_models[row].language;
+        row = score_language(ws, row, total, scores[language]);
+        if (best == TELLENC_LANG_UNKNOWN || scores[language] > scores[best]) {
+            best = tellenc_language_t(language);
+        }
+    }
+    double sum = 0;
+    for (int language = TELLENC_LANG_UNKNOWN + 1;
+            language < TELLENC_LANGUAGE_COUNT; ++language) {
+        sum += exp(scores[language] - scores[best]);
+    }
+    ws.language = best;
+    ws.language_confidence = 1 / sum;
+}
+
+template <typename Policy>
+inline tellenc_encoding_t finish(tellenc_workspace_t& ws)
+{
+    if (ws.pos == 0) {
+        return TELLENC_UNKNOWN;
+    }
+    if (ws.head_enc != TELLENC_UNKNOWN) {
+        ws.confidence = 1;
+        return ws.head_enc;
+    }
+
+    // Not checked in scan
+    if (!is_enabled<Policy>(ws, TELLENC_UTF_8)) {
+        ws.is_valid_utf8 = false;
+        ws.is_mostly_utf8 = false;
+    }
+    if (!is_enabled<Policy>(ws, TELLENC_LATIN1)) {
+        ws.is_valid_latin1 = false;
+    }
+
+    // A text shorter than DECL_SNIFF_BYTES is searched only now
+    if (ws.sniff_declared && ws.decl_len < DECL_SNIFF_BYTES) {
+        ws.declared_enc = sniff_declared(ws.decl_buf, ws.decl_len);
+    }
+
+    // A four-byte sequence cut by the end is broken
+    if (ws.gb4_state != GB4_NONE) {
+        count_broken_gb4(ws, is_wanted_freq_tables<Policy>(ws));
+        ws.gb4_state = GB4_NONE;
+    }
+    if (ws.use_dbyte_sketch) {
+        copy_dbyte_sketch(ws);
+    }
+
+    // DOS EOF is only allowed as the last character
+    tellenc_count_t dos_eof_cnt = ws.sbyte_char_cnt[(unsigned char)DOS_EOF];
+    if (dos_eof_cnt > 1 ||
+            (dos_eof_cnt == 1 && ws.prev_ch != (unsigned char)DOS_EOF)) {
+        ws.is_binary = true;
+    }
+
+    if (ws.verbose) {
+        rank_dbytes(ws, true);
+        print_sbyte_char_cnt(ws);
+        print_dbyte_char_cnt(ws);
+        printf("%.0f characters\n", double(ws.pos));
+        printf("%.0f double-byte characters\n", double(ws.dbyte_cnt));
+        printf("%.0f double-byte hi-hi characters\n",
+               double(ws.dbyte_hihi_cnt));
+        printf("%u unique double-byte characters\n", ws.dbyte_uniq_cnt);
+        if (ws.gb18030_cnt != 0) {
+            printf("%.0f four-byte GB18030 characters\n",
+                   double(ws.gb18030_cnt));
+        }
+        for (int order = UCS4_BE; order <= UCS4_LE; ++order) {
+            if (ws.ucs4_valid[order] && ws.pos >= 4 &&
+                    is_enabled<Policy>(ws, order == UCS4_BE
+                                               ? TELLENC_UCS_4
+                                               : TELLENC_UCS_4LE)) {
+                printf("Valid UCS-4 (%s), %u%% printable\n",
+                       order == UCS4_BE ? "big-endian" : "little-endian",
+                       unsigned(ws.ucs4_printable_cnt[order] * 100.0 /
+                                (ws.pos / 4)));
+            }
+        }
+        if (ws.declared_enc != TELLENC_UNKNOWN) {
+            printf("Declared charset: %s\n",
+                   encoding_info[ws.declared_enc].name);
+        }
+        if (ws.utf8_errors != 0 && ws.is_mostly_utf8) {
+            printf("%.0f invalid UTF-8 sequences (%.2f%%), at",
+                   double(ws.utf8_errors), 100 * utf8_error_rate(ws));
+            for (size_t i = 0; i < ws.utf8_errors &&
+                                 i < MAX_UTF8_ERROR_OFFSETS; ++i) {
+                printf(" %.0f", double(ws.utf8_error_offsets[i]));
+            }
+            printf(ws.utf8_errors > MAX_UTF8_ERROR_OFFSETS ? " ...\n" : "\n");
+        }
+        if (ws.utf8_double_cnt != 0) {
+            printf("%.0f of %.0f non-ASCII characters double-encoded"
+                   " (%.0f%%)\n",
+                   double(ws.utf8_double_cnt), double(ws.utf8_char_cnt),
+                   100.0 * ws.utf8_double_cnt / ws.utf8_char_cnt);
+        }
+        printf("Line endings: %.0f LF, %.0f CRLF, %.0f CR\n",
+               double(ws.sbyte_char_cnt[(unsigned char)'\n'] - ws.crlf_cnt),
+               double(ws.crlf_cnt),
+               double(ws.sbyte_char_cnt[(unsigned char)'\r'] - ws.crlf_cnt));
+        printf("Lines indented: %.0f with tabs, %.0f with spaces\n",
+               double(ws.tab_indent_cnt), double(ws.space_indent_cnt));
+    }
+
+    // The detectors of the first bytes have run unless the text is short
+    unsigned done = 0;
+    if (ws.head_len == sizeof ws.head) {
+        done = TELLENC_EVIDENCE_HEAD;
+    }
+    // After an early stop, the text scanned is detected as if it were all
+    if (ws.sole_enc != TELLENC_UNKNOWN && ws.verbose) {
+        printf("Stopped with %s the only candidate left\n",
+               encoding_info[ws.sole_enc].name);
+    }
+    tellenc_encoding_t enc = run_detectors<Policy>(ws, ~0U, done);
+    ws.confidence = detection_confidence<Policy>(ws, enc);
+    if (ws.verbose && enc != TELLENC_UNKNOWN) {
+        printf("Confidence: %.0f%%\n", 100 * ws.confidence);
+    }
+    identify_language(ws, enc);
+    if (ws.verbose && ws.language != TELLENC_LANG_UNKNOWN) {
+        printf("Language: %s (%.0f%%)\n", language_names[ws.language],
+               100 * ws.language_confidence);
+    }
+    return enc;
+}
+
+template <typename Policy>
+inline tellenc_encoding_t detect(tellenc_workspace_t& ws,
+                          const unsigned char* const buffer,
+                          const size_t len)
+{
+    reset_state(ws);
+    feed<Policy>(ws, buffer, len);
+    return finish<Policy>(ws);
+}
+
+template <typename Policy>
+inline tellenc_encoding_t simplify(const tellenc_workspace_t& ws,
+                                   const tellenc_encoding_t enc)
+{
+    if (enc == TELLENC_WINDOWS_1252 && ws.is_valid_latin1 &&
+            is_enabled<Policy>(ws, TELLENC_LATIN1)) {
+        // Latin1 is subset of Windows-1252
+        return TELLENC_LATIN1;
+    } else if (enc == TELLENC_GBK && ws.dbyte_hihi_cnt == ws.dbyte_cnt &&
+               is_enabled<Policy>(ws, TELLENC_GB2312)) {
+        // Special case for GB2312: no high-byte followed by a low-byte
+        return TELLENC_GB2312;
+    } else if (enc == TELLENC_ASCII &&
+               !is_enabled<Policy>(ws, TELLENC_ASCII)) {
+        // ASCII is a subset of all the ASCII-compatible encodings
+        if (is_enabled<Policy>(ws, TELLENC_UTF_8)) {
+            return TELLENC_UTF_8;
+        } else if (is_enabled<Policy>(ws, TELLENC_LATIN1)) {
+            return TELLENC_LATIN1;
+        }
+        for (int i = TELLENC_ASCII; i < TELLENC_ENCODING_COUNT; ++i) {
+            if (encoding_info[i].ascii_compatible &&
+                    is_enabled<Policy>(ws, tellenc_encoding_t(i))) {
+                return tellenc_encoding_t(i);
+            }
+        }
+    }
+    if (enc == TELLENC_BINARY || is_enabled<Policy>(ws, enc)) {
+        return enc;
+    }
+    return TELLENC_UNKNOWN;
+}
+
+inline const char* legacy_name(tellenc_encoding_t enc, size_t len)
+{
+    if (enc == TELLENC_UNKNOWN && len != 0) {
+        return NULL;
+    }
+    return encoding_info[enc].name;
+}
+
+inline void prefetch(const unsigned char* buffer, size_t len)
+{
+    len = std::min(len, PREFETCH_BYTES);
+    for (size_t i = 0; i < len; i += CACHE_LINE) {
+        TELLENC_PREFETCH(buffer + i);
+    }
+}
+
+template <typename OutputIt>
+void detect_batch(tellenc_workspace_t& ws,
+                  const unsigned char* const* buffers,
+                  const size_t* lens, size_t count,
+                  OutputIt results)
+{
+    // While a buffer is scanned, the start of a later one is loaded
+    for (size_t i = 0; i < std::min(count, PREFETCH_DISTANCE); ++i) {
+        prefetch(buffers[i], lens[i]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (i + PREFETCH_DISTANCE < count) {
+            prefetch(buffers[i + PREFETCH_DISTANCE],
+                     lens[i + PREFETCH_DISTANCE]);
+        }
+        results[i] = simplify<tellenc_all_encodings>(
+            ws, detect<tellenc_all_encodings>(ws, buffers[i], lens[i]));
+    }
+}
+
+inline tellenc_workspace_t& default_workspace()
+{
+    static tellenc_workspace_t ws;
+    return ws;
+}
+
+} // namespace tellenc_detail
+
+/** Gets the static information about an encoding. */
+inline const tellenc_encoding_info_t& tellenc_encoding_info(
+        tellenc_encoding_t enc) TELLENC_NOEXCEPT
+{
+    if ((unsigned)enc >= TELLENC_ENCODING_COUNT) {
+        enc = TELLENC_UNKNOWN;
+    }
+    return tellenc_detail::encoding_info[enc];
+}
+
+/** Gets the name of an encoding, like "utf-8" or "gbk". */
+inline const char* tellenc_encoding_name(tellenc_encoding_t enc)
+    TELLENC_NOEXCEPT
+{
+    return tellenc_encoding_info(enc).name;
+}
+
+/**
+ * Gets the encoding of a name, an IANA name or an alias, ignoring case;
+ * TELLENC_UNKNOWN if not found.
+ */
+inline tellenc_encoding_t tellenc_encoding_from_name(const char* name,
+                                                     size_t len)
+    TELLENC_NOEXCEPT
+{
+    return tellenc_detail::encoding_of_name(name, len);
+}
+
+inline tellenc_encoding_t tellenc_encoding_from_name(const char* name)
+    TELLENC_NOEXCEPT
+{
+    return name ? tellenc_encoding_from_name(name, strlen(name))
+                : TELLENC_UNKNOWN;
+}
+
+/** Gets the ISO 639-1 code of a language, like "fr"; "unknown" if none. */
+inline const char* tellenc_language_name(tellenc_language_t lang)
+    TELLENC_NOEXCEPT
+{
+    if ((unsigned)lang >= TELLENC_LANGUAGE_COUNT) {
+        lang = TELLENC_LANG_UNKNOWN;
+    }
+    return tellenc_detail::language_names[lang];
+}
+
+/**
+ * Detects the encoding of a buffer.  Latin1 and GB2312 are reported
+ * when the text fits in these subsets of Windows-1252 and GBK.
+ *
+ * @param ws      workspace to use; it holds the statistics afterwards
+ * @param buffer  pointer to the text
+ * @param len     length of the text in bytes
+ * @return        the detected encoding, or TELLENC_UNKNOWN
+ */
+inline tellenc_encoding_t tellenc_detect(tellenc_workspace_t& ws,
+                                         const unsigned char* buffer,
+                                         size_t len) TELLENC_NOEXCEPT
+{
+    using namespace tellenc_detail;
+    return simplify<tellenc_all_encodings>(
+        ws, detect<tellenc_all_encodings>(ws, buffer, len));
+}
+
+/**
+ * Same as tellenc_detect, but only looks for the encodings enabled by
+ *  Policy, like tellenc_chinese_encodings; the others are reported as
+ * TELLENC_UNKNOWN.  ASCII text is reported as UTF-8 or Latin1 if ASCII
+ * is not enabled.
+ */
+template <typename Policy>
+tellenc_encoding_t tellenc_detect(tellenc_workspace_t& ws,
+                                  const unsigned char* buffer,
+                                  size_t len) TELLENC_NOEXCEPT
+{
+    using namespace tellenc_detail;
+    return simplify<Policy>(ws, detect<Policy>(ws, buffer, len));
+}
+
+/** Starts an incremental detection with tellenc_feed. */
+inline void tellenc_begin(tellenc_workspace_t& ws) TELLENC_NOEXCEPT
+{
+    tellenc_detail::reset_state(ws);
+}
+
+/**
+ * Feeds the next chunk of the text to an incremental detection.
+ *
+ * @return  \c true if the encoding is already decided, so that the rest
+ *          of the text need not be fed
+ */
+inline bool tellenc_feed(tellenc_workspace_t& ws,
+                         const unsigned char* buffer,
+                         size_t len) TELLENC_NOEXCEPT
+{
+    return tellenc_detail::feed<tellenc_all_encodings>(ws, buffer, len);
+}
+
+/** Same as tellenc_feed, for a detection with tellenc_finish<Policy>. */
+template <typename Policy>
+bool tellenc_feed(tellenc_workspace_t& ws,
+                  const unsigned char* buffer,
+                  size_t len) TELLENC_NOEXCEPT
+{
+    return tellenc_detail::feed<Policy>(ws, buffer, len);
+}
+
+/**
+ * Finishes an incremental detection.  The result is the same as that
+ * of tellenc_detect on the concatenation of all the chunks fed.
+ */
+inline tellenc_encoding_t tellenc_finish(tellenc_workspace_t& ws)
+    TELLENC_NOEXCEPT
+{
+    using namespace tellenc_detail;
+    return simplify<tellenc_all_encodings>(
+        ws, finish<tellenc_all_encodings>(ws));
+}
+
+/**
+ * Same as tellenc_finish, but only reports the encodings enabled by
+ * \a Policy, like tellenc_detect<Policy>.
+ */
+template <typename Policy>
+tellenc_encoding_t tellenc_finish(tellenc_workspace_t& ws) TELLENC_NOEXCEPT
+{
+    using namespace tellenc_detail;
+    return simplify<Policy>(ws, finish<Policy>(ws));
+}
+
+/**
+ * Gets the ratio of the non-ASCII characters of valid UTF-8 text that
+ * look double-encoded: UTF-8 decoded as Windows-1252 or Latin1 and
+ * encoded as UTF-8 again.  Valid after a detection.
+ */
+inline double tellenc_double_encoded_ratio(const tellenc_workspace_t& ws)
+    TELLENC_NOEXCEPT
+{
+    if (!ws.is_valid_utf8 || ws.utf8_char_cnt == 0) {
+        return 0;
+    }
+    return double(ws.utf8_double_cnt) / ws.utf8_char_cnt;
+}
+
+/**
+ * Gets the share of invalid sequences among the non-ASCII sequences of
+ * text checked as UTF-8; their first offsets are in utf8_error_offsets.
+ * It is 1 if the check stopped as the text is clearly not UTF-8.  Valid
+ * after a detection.
+ */
+inline double tellenc_utf8_error_rate(const tellenc_workspace_t& ws)
+    TELLENC_NOEXCEPT
+{
+    return ws.is_mostly_utf8 ? tellenc_detail::utf8_error_rate(ws) : 1;
+}
+
+/**
+ * Checks whether text detected as UTF-8 is mostly double-encoded, so
+ * that it should be reported as "utf-8 (double-encoded)".
+ */
+inline bool tellenc_is_double_encoded(const tellenc_workspace_t& ws)
+    TELLENC_NOEXCEPT
+{
+    return tellenc_double_encoded_ratio(ws) >=
+           tellenc_detail::MIN_DOUBLE_ENCODED_RATIO;
+}
+
+/**
+ * Gets the likely language of the text, found from the letter counts of
+ * the same scan, and the probability of it against the other languages
+ * in \a confidence if not NULL.  It is TELLENC_LANG_UNKNOWN when the
+ * letters are too few, and for UTF-16/32 or text with a BOM.  Valid
+ * after a detection.
+ */
+inline tellenc_language_t tellenc_language(const tellenc_workspace_t& ws,
+                                           double* confidence = NULL)
+    TELLENC_NOEXCEPT
+{
+    if (confidence) {
+        *confidence = ws.language_confidence;
+    }
+    return ws.language;
+}
+
+/**
+ * Gets how sure the detected encoding is, from 0 to 1: 1 when the
+ * structure of the text tells it, less when it is guessed from
+ * statistics, and 0 when unknown.  Valid after a detection.
+ */
+inline double tellenc_confidence(const tellenc_workspace_t& ws)
+    TELLENC_NOEXCEPT
+{
+    return ws.confidence;
+}
+
+/**
+ * Gets the line endings, tabs, indentation, BOM and end of the text.
+ * Valid after a detection; only the BOM is known when the text starts
+ * with one, as the rest is not scanned.
+ */
+inline tellenc_text_info_t tellenc_text_info(const tellenc_workspace_t& ws)
+    TELLENC_NOEXCEPT
+{
+    using namespace tellenc_detail;
+    tellenc_text_info_t info;
+    info.crlf_count = ws.crlf_cnt;
+    info.lf_count = ws.sbyte_char_cnt[(unsigned char)'\n'] - ws.crlf_cnt;
+    info.cr_count = ws.sbyte_char_cnt[(unsigned char)'\r'] - ws.crlf_cnt;
+    info.tab_count = ws.sbyte_char_cnt[(unsigned char)'\t'];
+    info.tab_indented = ws.tab_indent_cnt;
+    info.space_indented = ws.space_indent_cnt;
+    int kinds = (info.lf_count != 0) + (info.crlf_count != 0) +
+                (info.cr_count != 0);
+    if (kinds > 1) {
+        info.line_ending = TELLENC_EOL_MIXED;
+    } else if (info.lf_count != 0) {
+        info.line_ending = TELLENC_EOL_LF;
+    } else if (info.crlf_count != 0) {
+        info.line_ending = TELLENC_EOL_CRLF;
+    } else if (info.cr_count != 0) {
+        info.line_ending = TELLENC_EOL_CR;
+    } else {
+        info.line_ending = TELLENC_EOL_NONE;
+    }
+    info.has_bom = check_ucs_bom(ws.head, ws.head_len) != TELLENC_UNKNOWN;
+    info.has_dos_eof = ws.pos != 0 &&
+                       ws.prev_ch == (unsigned char)DOS_EOF &&
+                       ws.sbyte_char_cnt[(unsigned char)DOS_EOF] == 1;
+    info.has_final_newline = ws.pos != 0 &&
+                             ws.eol_end == ws.pos - info.has_dos_eof;
+    return info;
+}
+
+/**
+ * Merges the double-byte summary of another part of a text into \a to.
+ * A double-byte not kept by one summary may have occurred as often as
+ * its smallest count, which is added to the count and the error; of
+ * them all, the DBYTE_SKETCH_SIZE most frequent are kept.
+ */
+inline void tellenc_merge_dbyte_sketch(tellenc_dbyte_sketch_t& to,
+                                       const tellenc_dbyte_sketch_t& from)
+    TELLENC_NOEXCEPT
+{
+    using tellenc_detail::find_in_sketch;
+    using tellenc_detail::sketch_entry;
+    const size_t max_entries = tellenc_detail::DBYTE_SKETCH_SIZE;
+    sketch_entry entries[max_entries * 2];
+    size_t entry_cnt = 0;
+    tellenc_count_t to_min = tellenc_detail::sketch_min_count(to);
+    tellenc_count_t from_min = tellenc_detail::sketch_min_count(from);
+    for (size_t i = 0; i < to.size; ++i) {
+        sketch_entry& entry = entries[entry_cnt++];
+        tellenc_detail::uint32_t j = find_in_sketch(from, to.dbytes[i]);
+        entry.dbyte = to.dbytes[i];
+        entry.count = to.counts[i] + (j ? from.counts[j - 1] : from_min);
+        entry.error = to.errors[i] + (j ? from.errors[j - 1] : from_min);
+    }
+    for (size_t i = 0; i < from.size; ++i) {
+        if (find_in_sketch(to, from.dbytes[i]) == 0) {
+            sketch_entry& entry = entries[entry_cnt++];
+            entry.dbyte = from.dbytes[i];
+            entry.count = from.counts[i] + to_min;
+            entry.error = from.errors[i] + to_min;
+        }
+    }
+    size_t kept = std::min(entry_cnt, max_entries);
+    std::partial_sort(entries, entries + kept, entries + entry_cnt,
+                      tellenc_detail::greater_sketch_count);
+    to.size = 0;
+    memset(to.buckets, 0, sizeof to.buckets);
+    for (size_t i = 0; i < kept; ++i) {
+        tellenc_detail::add_to_sketch(to, entries[i].dbyte, entries[i].count,
+                                      entries[i].error);
+    }
+}
+
+/**
+ * Restricts the encodings that a workspace may report to \a count
+ * candidates, weighted by \a priors (all 1 if NULL) where the statistics
+ * only favour one encoding over another.  The checks and tables of the
+ * other encodings are skipped, and with ws.stop_early set, the scan
+ * stops as soon as one candidate is left that fits the text.  ASCII
+ * text is reported as an ASCII-compatible candidate if ASCII is not one.
+ * A \a count of 0 allows all the encodings again.
+ *
+ * @return  false if an encoding or a prior (which must be positive) is
+ *          invalid; the candidates are unchanged then
+ */
+inline bool tellenc_set_candidates(tellenc_workspace_t& ws,
+                                   const tellenc_encoding_t* encodings,
+                                   const double* priors,
+                                   size_t count) TELLENC_NOEXCEPT
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (encodings[i] <= TELLENC_UNKNOWN ||
+                encodings[i] >= TELLENC_ENCODING_COUNT ||
+                (priors && !(priors[i] > 0))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < TELLENC_ENCODING_COUNT; ++i) {
+        ws.is_candidate[i] = count == 0;
+        ws.priors[i] = 1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        ws.is_candidate[encodings[i]] = true;
+        ws.priors[encodings[i]] = priors ? priors[i] : 1;
+    }
+
+    // The supersets looked for to find Latin1 and GB2312 share weights
+    if (!ws.is_candidate[TELLENC_WINDOWS_1252]) {
+        ws.priors[TELLENC_WINDOWS_1252] = ws.priors[TELLENC_LATIN1];
+    }
+    if (!ws.is_candidate[TELLENC_GBK]) {
+        ws.priors[TELLENC_GBK] = ws.priors[TELLENC_GB2312];
+    }
+    ws.max_prior = 0;
+    for (int i = 0; i < TELLENC_ENCODING_COUNT; ++i) {
+        if (ws.priors[i] > ws.max_prior) {
+            ws.max_prior = ws.priors[i];
+        }
+    }
+    ws.has_candidates = count != 0;
+    return true;
+}
+
+/**
+ * Adds a detector to a workspace, for an encoding or format not built
+ * in.  It runs among the built-in detectors in the order of its cost
+ * (which are 1 for BOMs, 10 for UTF-8, 100 for the frequency tables and
+ * 1000 for the single-byte guess), and sees the same statistics.
+ *
+ * @param ws        workspace to add to
+ * @param detector  detector, which must outlive the workspace
+ * @return          \c false if the workspace already has 8 detectors
+ */
+inline bool tellenc_add_detector(tellenc_workspace_t& ws,
+                                 const tellenc_detector_t& detector)
+    TELLENC_NOEXCEPT
+{
+    if (ws.detector_count == tellenc_detail::MAX_DETECTORS) {
+        return false;
+    }
+
+    // Keep them sorted by cost, after those of the same cost
+    size_t i = ws.detector_count++;
+    for (; i > 0 && ws.detectors[i - 1]->cost > detector.cost; --i) {
+        ws.detectors[i] = ws.detectors[i - 1];
+    }
+    ws.detectors[i] = &detector;
+    return true;
+}
+
+#if TELLENC_HAS_STRING_VIEW
+inline tellenc_encoding_t tellenc_detect(tellenc_workspace_t& ws,
+                                         std::string_view text) noexcept
+{
+    return tellenc_detect(
+        ws, reinterpret_cast<const unsigned char*>(text.data()),
+        text.size());
+}
+#endif
+
+#if TELLENC_HAS_SPAN
+inline tellenc_encoding_t tellenc_detect(tellenc_workspace_t& ws,
+                                         std::span<const std::byte> data)
+    noexcept
+{
+    return tellenc_detect(
+        ws, reinterpret_cast<const unsigned char*>(data.data()),
+        data.size());
+}
+#endif
+
+/**
+ * Detects the encodings of many buffers.  It saves the per-call costs of
+ * tellenc_detect, and prefetches upcoming buffers to hide memory
+ * latency.  The statistics in the workspace are those of the last
+ * buffer afterwards.
+ *
+ * @param ws       workspace to use
+ * @param buffers  array of \a count pointers to the texts
+ * @param lens     array of \a count lengths of the texts
+ * @param count    number of texts
+ * @param results  where the \a count encodings are stored, like an
+ *                 array of tellenc_encoding_t or int
+ */
+template <typename OutputIt>
+void tellenc_detect_batch(tellenc_workspace_t& ws,
+                          const unsigned char* const* buffers,
+                          const size_t* lens, size_t count,
+                          OutputIt results) TELLENC_NOEXCEPT
+{
+    tellenc_detail::detect_batch(ws, buffers, lens, count, results);
+}
+
+#if TELLENC_HAS_PMR
+/**
+ * Creates a workspace in memory from \a resource, like a per-thread
+ * arena or pool, instead of the global heap.  Detection itself never
+ * allocates, so this is the only memory a detector needs.
+ *
+ * @throw std::bad_alloc  when \a resource is out of memory
+ */
+inline tellenc_workspace_t* tellenc_new_workspace(
+        std::pmr::memory_resource* resource)
+{
+    void* ptr = resource->allocate(sizeof(tellenc_workspace_t),
+                                   alignof(tellenc_workspace_t));
+    return new(ptr) tellenc_workspace_t;
+}
+
+/** Destroys a workspace created by tellenc_new_workspace. */
+inline void tellenc_delete_workspace(tellenc_workspace_t* ws,
+                                     std::pmr::memory_resource* resource)
+    noexcept
+{
+    if (ws) {
+        ws->~tellenc_workspace_t();
+        resource->deallocate(ws, sizeof(tellenc_workspace_t),
+                             alignof(tellenc_workspace_t));
+    }
+}
+#endif
+
+/**
+ * Sets whether detections with the shared workspace of tellenc and
+ * tellenc_simplify print their statistics.
+ */
+inline void tellenc_set_verbose(bool verbose)
+{
+    tellenc_detail::default_workspace().verbose = verbose;
+}
+
+/**
+ * Detects the encoding of a buffer.  It is kept for compatibility, and
+ * uses one static workspace, shared with tellenc_simplify: it is not
+ * thread-safe, and the calls must not overlap.  tellenc_detect with a
+ * workspace per thread has no such limit.
+ *
+ * @return  the encoding name, "unknown" for empty input, or \c NULL
+ */
+inline const char* tellenc(const unsigned char* const buffer,
+                           const size_t len)
+{
+    using namespace tellenc_detail;
+    return legacy_name(
+        detect<tellenc_all_encodings>(default_workspace(), buffer, len), len);
+}
+
+/**
+ * Same as tellenc, but Latin1 and GB2312 are reported when the text
+ * fits in these subsets of Windows-1252 and GBK.  It uses the same
+ * static workspace, so it is not thread-safe either.
+ */
+inline const char* tellenc_simplify(const char* const buffer,
+                                    const size_t len)
+{
+    using namespace tellenc_detail;
+    tellenc_workspace_t& ws = default_workspace();
+    return legacy_name(
+        simplify<tellenc_all_encodings>(
+            ws, detect<tellenc_all_encodings>(
+                    ws, (const unsigned char*)buffer, len)),
+        len);
+}
+
+/**
+ * @deprecated  Does nothing, as the UTF-8 table is built at compile
+ *              time; kept only so that old callers still build.
+ */
+inline void init_utf8_char_table()
+{
+}
+
+#endif // TELLENC_H
@@ -0,0 +1,281 @@
+﻿// vim: expandtab shiftwidth=4 softtabstop=4 tabstop=4
+
+/*
+ * Copyright (C) 2006-2016 Wu Yongwei <wuyongwei@gmail.com>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must
+ *    not claim that you wrote the original software.  If you use this
+ *    software in a product, an acknowledgement in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must
+ *    not be misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source
+ *    distribution.
+ *
+ *
+ * The latest version of this software should be available at:
+ *      <URL:https://github.com/adah1972/tellenc>
+ *
+ */
+
+/**
+ * @file    tellenc_async.h
+ *
+ * Awaitable encoding detection for C++20 coroutines.  Text is pulled
+ * chunk by chunk from an asynchronous byte source, and the detection
+ * finishes as soon as the encoding is decided or the source ends.
+ *
+ * A byte source is any object with a member function \c next() whose
+ * result, when \c co_await'ed, is a std::span<const unsigned char> of
+ * the next chunk, empty at the end.  A chunk only needs to stay valid
+ * until the next call to \c next().
+ *
+ * tellenc_local_executor, tellenc_memory_source and tellenc_sync_wait
+ * allow running detections without any event loop, e.g. in tests.
+ *
+ * @version 1.22, 2016/07/26
+ * @author  Wu Yongwei
+ */
+
+#ifndef TELLENC_ASYNC_H
+#define TELLENC_ASYNC_H
+
+#include "tellenc.h"
+
+#if !defined(__cpp_impl_coroutine) || !TELLENC_HAS_SPAN
+#error "tellenc_async.h requires C++20 coroutines and std::span"
+#endif
+
+#include <algorithm>        // min
+#include <coroutine>        // coroutine_handle/suspend_always
+#include <deque>            // deque
+#include <exception>        // exception_ptr
+#include <stdexcept>        // logic_error
+#include <utility>          // exchange
+
+/**
+ * Lazily started coroutine producing a value of type \a T, which can be
+ * \c co_await'ed by another coroutine, or run by tellenc_sync_wait.
+ */
+template <typename T>
+class [[nodiscard]] tellenc_task {
+public:
+    struct promise_type {
+        T                       value{};
+        std::exception_ptr      exception;
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        tellenc_task get_return_object() noexcept
+        {
+            return tellenc_task(handle_type::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept
+        {
+            struct final_awaiter {
+                bool await_ready() noexcept { return false; }
+                std::coroutine_handle<> await_suspend(
+                        std::coroutine_handle<promise_type> handle) noexcept
+                {
+                    return handle.promise().continuation;
+                }
+                void await_resume() noexcept {}
+            };
+            return final_awaiter{};
+        }
+        void return_value(T result) noexcept { value = result; }
+        void unhandled_exception() noexcept
+        {
+            exception = std::current_exception();
+        }
+    };
+
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    tellenc_task(tellenc_task&& rhs) noexcept
+        : handle_(std::exchange(rhs.handle_, nullptr))
+    {
+    }
+    tellenc_task& operator=(tellenc_task&& rhs) noexcept
+    {
+        if (this != &rhs) {
+            destroy();
+            handle_ = std::exchange(rhs.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~tellenc_task() { destroy(); }
+
+    bool await_ready() const noexcept { return handle_.done(); }
+    std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> continuation) noexcept
+    {
+        handle_.promise().continuation = continuation;
+        return handle_;
+    }
+    T await_resume() { return result(); }
+
+    /** Starts or continues the coroutine in the calling thread. */
+    void resume() { handle_.resume(); }
+    bool done() const noexcept { return handle_.done(); }
+
+    /** Gets the result of a finished task, rethrowing its exception. */
+    T result()
+    {
+        if (handle_.promise().exception) {
+            std::rethrow_exception(handle_.promise().exception);
+        }
+        return handle_.promise().value;
+    }
+
+private:
+    explicit tellenc_task(handle_type handle) noexcept : handle_(handle) {}
+    void destroy() noexcept
+    {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    handle_type handle_;
+};
+
+/**
+ * Detects the encoding of the text from an asynchronous byte source.
+ * The source is not read any more once the encoding is decided or
+ * \a limit bytes have been read.
+ *
+ * @param ws      workspace to use; it must outlive the task
+ * @param source  byte source; it must outlive the task
+ * @param limit   maximum number of bytes to examine
+ */
+template <typename Source>
+tellenc_task<tellenc_encoding_t> tellenc_detect_async(
+        tellenc_workspace_t& ws, Source& source,
+        size_t limit = static_cast<size_t>(-1))
+{
+    tellenc_begin(ws);
+    while (limit != 0) {
+        std::span<const unsigned char> chunk = co_await source.next();
+        if (chunk.empty()) {
+            break;
+        }
+        size_t len = std::min(chunk.size(), limit);
+        limit -= len;
+        if (tellenc_feed(ws, chunk.data(), len)) {
+            break;
+        }
+    }
+    co_return tellenc_finish(ws);
+}
+
+/**
+ * Single-threaded run queue of coroutines.  Coroutines get into it by
+ * awaiting schedule(), and run when run_one() or run() is called.
+ */
+class tellenc_local_executor {
+public:
+    auto schedule() noexcept
+    {
+        struct awaiter {
+            tellenc_local_executor* executor;
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                executor->queue_.push_back(handle);
+            }
+            void await_resume() const noexcept {}
+        };
+        return awaiter{this};
+    }
+
+    /** Runs one queued coroutine; returns false if none is queued. */
+    bool run_one()
+    {
+        if (queue_.empty()) {
+            return false;
+        }
+        std::coroutine_handle<> handle = queue_.front();
+        queue_.pop_front();
+        handle.resume();
+        return true;
+    }
+
+    /** Runs queued coroutines until none is left. */
+    void run()
+    {
+        while (run_one()) {
+        }
+    }
+
+private:
+    std::deque<std::coroutine_handle<>> queue_;
+};
+
+/**
+ * Byte source over a memory buffer, returning chunks of at most
+ * \a chunk_size bytes.  With an executor, it suspends before each chunk
+ * as a real asynchronous source would.
+ */
+class tellenc_memory_source {
+public:
+    tellenc_memory_source(const unsigned char* data, size_t len,
+                          size_t chunk_size,
+                          tellenc_local_executor* executor = nullptr)
+        : data_(data), len_(len), chunk_size_(chunk_size ? chunk_size : 1),
+          executor_(executor)
+    {
+    }
+
+    tellenc_task<std::span<const unsigned char>> next()
+    {
+        if (executor_) {
+            co_await executor_->schedule();
+        }
+        size_t len = std::min(chunk_size_, len_ - pos_);
+        std::span<const unsigned char> chunk(data_ + pos_, len);
+        pos_ += len;
+        co_return chunk;
+    }
+
+    /** Gets the number of bytes returned so far. */
+    size_t bytes_read() const noexcept { return pos_; }
+
+private:
+    const unsigned char*    data_;
+    size_t                  len_;
+    size_t                  pos_ = 0;
+    size_t                  chunk_size_;
+    tellenc_local_executor* executor_;
+};
+
+/**
+ * Runs a task to completion in the calling thread, running the
+ * coroutines queued in \a executor while it waits, and returns its
+ * result.  The task may only wait for \a executor.
+ *
+ * @throw std::logic_error  if the task still waits for something else
+ *                          when \a executor has nothing left to run
+ */
+template <typename T>
+T tellenc_sync_wait(tellenc_local_executor& executor, tellenc_task<T>& task)
+{
+    task.resume();
+    while (!task.done() && executor.run_one()) {
+    }
+    if (!task.done()) {
+        throw std::logic_error(
+            "tellenc_sync_wait: task waits for another executor");
+    }
+    return task.result();
+}
+
+#endif // TELLENC_ASYNC_H
@@ -0,0 +1,462 @@
+﻿// vim: expandtab shiftwidth=4 softtabstop=4 tabstop=4
+
+/*
+ * Copyright (C) 2006-2016 Wu Yongwei <wuyongwei@gmail.com>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must
+ *    not claim that you wrote the original software.  If you use this
+ *    software in a product, an acknowledgement in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must
+ *    not be misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source
+ *    distribution.
+ *
+ *
+ * The latest version of this software should be available at:
+ *      <URL:https://github.com/adah1972/tellenc>
+ *
+ */
+
+/**
+ * @file    tellenc_c.cpp
+ *
+ * Implementation of the C interface in tellenc_c.h.
+ *
+ * @version 1.22, 2016/07/26
+ * @author  Wu Yongwei
+ */
+
+#include <new>              // nothrow/placement new
+#include <string.h>         // memcpy
+#include "tellenc.h"
+#include "tellenc_c.h"
+
+// The threads of TELLENC_OPTION_THREADS need C++11
+#if (__cplusplus >= 201103L || \
+     (defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)) && \
+    !defined(TELLENC_NO_THREADS)
+#include "tellenc_threads.h"
+#endif
+
+struct tellenc_ctx {
+    tellenc_workspace_t ws;
+    tellenc_encoding_t  result;
+    bool                feeding;
+
+    /// Workspaces for batches; the first is ws, the rest are owned
+    tellenc_workspace_t** workspaces;
+    size_t              thread_count;
+#if TELLENC_HAS_THREADS
+    tellenc_batch_pool* pool;           ///< Kept between batches
+#endif
+
+    tellenc_allocator   allocator;
+};
+
+template <typename T>
+struct alignment_of {
+    struct helper {
+        char    c;
+        T       t;
+    };
+    static const size_t value = sizeof(helper) - sizeof(T);
+};
+
+static void* default_allocate(void*, size_t size, size_t)
+{
+    return operator new(size, std::nothrow);
+}
+
+static void default_deallocate(void*, void* ptr, size_t)
+{
+    operator delete(ptr);
+}
+
+static const tellenc_allocator default_allocator = {
+    default_allocate,
+    default_deallocate,
+    NULL
+};
+
+template <typename T>
+static T* allocate(const tellenc_allocator& allocator, size_t count)
+{
+    return static_cast<T*>(allocator.allocate(allocator.user_data,
+                                              sizeof(T) * count,
+                                              alignment_of<T>::value));
+}
+
+template <typename T>
+static void deallocate(const tellenc_allocator& allocator, T* ptr,
+                       size_t count)
+{
+    allocator.deallocate(allocator.user_data, ptr, sizeof(T) * count);
+}
+
+#if TELLENC_HAS_THREADS
+static tellenc_workspace_t* new_workspace(const tellenc_allocator& allocator)
+{
+    void* ptr = allocate<tellenc_workspace_t>(allocator, 1);
+    return ptr ? new(ptr) tellenc_workspace_t : NULL;
+}
+#endif
+
+static void delete_workspace(const tellenc_allocator& allocator,
+                             tellenc_workspace_t* ws)
+{
+    ws->~tellenc_workspace_t();
+    deallocate(allocator, ws, 1);
+}
+
+static void free_workspaces(tellenc_ctx* ctx)
+{
+#if TELLENC_HAS_THREADS
+    if (ctx->pool) {
+        ctx->pool->~tellenc_batch_pool();
+        deallocate(ctx->allocator, ctx->pool, 1);
+        ctx->pool = NULL;
+    }
+#endif
+    if (ctx->workspaces) {
+        for (size_t i = 1; i < ctx->thread_count; ++i) {
+            delete_workspace(ctx->allocator, ctx->workspaces[i]);
+        }
+        deallocate(ctx->allocator, ctx->workspaces, ctx->thread_count);
+    }
+    ctx->workspaces = NULL;
+    ctx->thread_count = 1;
+}
+
+static void copy_options(const tellenc_workspace_t& from,
+                         tellenc_workspace_t& to)
+{
+    to.verbose = from.verbose;
+    to.sniff_declared = from.sniff_declared;
+    to.max_utf8_error_rate = from.max_utf8_error_rate;
+    memcpy(to.is_candidate, from.is_candidate, sizeof to.is_candidate);
+    memcpy(to.priors, from.priors, sizeof to.priors);
+    to.max_prior = from.max_prior;
+    to.has_candidates = from.has_candidates;
+    to.stop_early = from.stop_early;
+    to.use_dbyte_sketch = from.use_dbyte_sketch;
+}
+
+static bool set_thread_count(tellenc_ctx* ctx, long thread_count)
+{
+#if TELLENC_HAS_THREADS
+    if (thread_count < 1 ||
+            thread_count > (long)tellenc_detail::MAX_BATCH_THREADS) {
+        return false;
+    }
+    free_workspaces(ctx);
+    if (thread_count == 1) {
+        return true;
+    }
+    ctx->workspaces = allocate<tellenc_workspace_t*>(ctx->allocator,
+                                                     thread_count);
+    if (ctx->workspaces == NULL) {
+        return false;
+    }
+    ctx->workspaces[0] = &ctx->ws;
+    for (long i = 1; i < thread_count; ++i) {
+        tellenc_workspace_t* ws = new_workspace(ctx->allocator);
+        if (ws == NULL) {
+            // Only the workspaces created so far are freed
+            ctx->thread_count = i;
+            free_workspaces(ctx);
+            return false;
+        }
+        copy_options(ctx->ws, *ws);
+        ctx->workspaces[i] = ws;
+    }
+    ctx->thread_count = thread_count;
+    void* ptr = allocate<tellenc_batch_pool>(ctx->allocator, 1);
+    if (ptr == NULL) {
+        free_workspaces(ctx);
+        return false;
+    }
+    ctx->pool = new(ptr) tellenc_batch_pool(ctx->workspaces, thread_count);
+    return true;
+#else
+    (void)ctx;
+    return thread_count == 1;
+#endif
+}
+
+// Counts beyond SIZE_MAX, only possible on 32-bit systems, are capped
+static size_t count_stat(tellenc_count_t count)
+{
+    return count > tellenc_count_t(size_t(-1)) ? size_t(-1) : size_t(count);
+}
+
+static size_t text_info_stat(const tellenc_text_info_t& info, int stat)
+{
+    switch (stat) {
+    case TELLENC_STAT_LINE_ENDING:
+        return info.line_ending;
+    case TELLENC_STAT_LF:
+        return count_stat(info.lf_count);
+    case TELLENC_STAT_CRLF:
+        return count_stat(info.crlf_count);
+    case TELLENC_STAT_CR:
+        return count_stat(info.cr_count);
+    case TELLENC_STAT_TABS:
+        return count_stat(info.tab_count);
+    case TELLENC_STAT_TAB_INDENTED:
+        return count_stat(info.tab_indented);
+    case TELLENC_STAT_SPACE_INDENTED:
+        return count_stat(info.space_indented);
+    case TELLENC_STAT_HAS_BOM:
+        return info.has_bom;
+    case TELLENC_STAT_FINAL_NEWLINE:
+        return info.has_final_newline;
+    case TELLENC_STAT_DOS_EOF:
+        return info.has_dos_eof;
+    default:
+        return 0;
+    }
+}
+
+int tellenc_abi_version(void)
+{
+    return TELLENC_ABI_VERSION;
+}
+
+const char* tellenc_encoding_name_of(int encoding)
+{
+    return tellenc_encoding_name(tellenc_encoding_t(encoding));
+}
+
+int tellenc_encoding_id_of(const char* name)
+{
+    return tellenc_encoding_from_name(name);
+}
+
+const char* tellenc_encoding_iana_name_of(int encoding)
+{
+    return tellenc_encoding_info(tellenc_encoding_t(encoding)).iana_name;
+}
+
+int tellenc_encoding_byte_width_of(int encoding)
+{
+    return tellenc_encoding_info(tellenc_encoding_t(encoding)).byte_width;
+}
+
+int tellenc_encoding_is_ascii_compatible(int encoding)
+{
+    return tellenc_encoding_info(tellenc_encoding_t(encoding))
+               .ascii_compatible;
+}
+
+tellenc_ctx* tellenc_ctx_create(void)
+{
+    return tellenc_ctx_create_with_allocator(&default_allocator);
+}
+
+tellenc_ctx* tellenc_ctx_create_with_allocator(
+        const tellenc_allocator* allocator)
+{
+    void* ptr = allocate<tellenc_ctx>(*allocator, 1);
+    if (ptr == NULL) {
+        return NULL;
+    }
+    tellenc_ctx* ctx = new(ptr) tellenc_ctx;
+    ctx->workspaces = NULL;
+    ctx->thread_count = 1;
+#if TELLENC_HAS_THREADS
+    ctx->pool = NULL;
+#endif
+    ctx->allocator = *allocator;
+    tellenc_ctx_reset(ctx);
+    return ctx;
+}
+
+void tellenc_ctx_reset(tellenc_ctx* ctx)
+{
+    tellenc_begin(ctx->ws);
+    ctx->result = TELLENC_UNKNOWN;
+    ctx->feeding = false;
+}
+
+void tellenc_ctx_destroy(tellenc_ctx* ctx)
+{
+    if (ctx) {
+        free_workspaces(ctx);
+        tellenc_allocator allocator = ctx->allocator;
+        ctx->~tellenc_ctx();
+        deallocate(allocator, ctx, 1);
+    }
+}
+
+int tellenc_ctx_set_option(tellenc_ctx* ctx, int option, long value)
+{
+    switch (option) {
+    case TELLENC_OPTION_VERBOSE:
+        ctx->ws.verbose = value != 0;
+        for (size_t i = 1; i < ctx->thread_count; ++i) {
+            ctx->workspaces[i]->verbose = ctx->ws.verbose;
+        }
+        return 0;
+    case TELLENC_OPTION_THREADS:
+        return set_thread_count(ctx, value) ? 0 : -1;
+    case TELLENC_OPTION_SNIFF_DECLARED:
+        ctx->ws.sniff_declared = value != 0;
+        for (size_t i = 1; i < ctx->thread_count; ++i) {
+            ctx->workspaces[i]->sniff_declared = ctx->ws.sniff_declared;
+        }
+        return 0;
+    case TELLENC_OPTION_MAX_UTF8_ERRORS:
+        if (value < 0 || value > 1000000) {
+            return -1;
+        }
+        ctx->ws.max_utf8_error_rate = value / 1e6;
+        for (size_t i = 1; i < ctx->thread_count; ++i) {
+            ctx->workspaces[i]->max_utf8_error_rate =
+                ctx->ws.max_utf8_error_rate;
+        }
+        return 0;
+    case TELLENC_OPTION_DBYTE_SKETCH:
+        ctx->ws.use_dbyte_sketch = value != 0;
+        for (size_t i = 1; i < ctx->thread_count; ++i) {
+            ctx->workspaces[i]->use_dbyte_sketch = ctx->ws.use_dbyte_sketch;
+        }
+        return 0;
+    case TELLENC_OPTION_STOP_EARLY:
+        ctx->ws.stop_early = value != 0;
+        for (size_t i = 1; i < ctx->thread_count; ++i) {
+            ctx->workspaces[i]->stop_early = ctx->ws.stop_early;
+        }
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+int tellenc_ctx_set_candidates(tellenc_ctx* ctx, const int* encodings,
+                               const double* priors, size_t count)
+{
+    tellenc_encoding_t candidates[TELLENC_ENCODING_COUNT];
+    if (count > TELLENC_ENCODING_COUNT) {
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        candidates[i] = tellenc_encoding_t(encodings[i]);
+    }
+    if (!tellenc_set_candidates(ctx->ws, candidates, priors, count)) {
+        return -1;
+    }
+    for (size_t i = 1; i < ctx->thread_count; ++i) {
+        copy_options(ctx->ws, *ctx->workspaces[i]);
+    }
+    return 0;
+}
+
+int tellenc_ctx_detect(tellenc_ctx* ctx, const void* buffer, size_t len)
+{
+    ctx->feeding = false;
+    ctx->result = tellenc_detect(ctx->ws, (const unsigned char*)buffer, len);
+    return ctx->result;
+}
+
+int tellenc_ctx_feed(tellenc_ctx* ctx, const void* buffer, size_t len)
+{
+    // The statistics of the last detection are kept until new data come
+    if (!ctx->feeding) {
+        tellenc_begin(ctx->ws);
+        ctx->feeding = true;
+    }
+    return tellenc_feed(ctx->ws, (const unsigned char*)buffer, len);
+}
+
+int tellenc_ctx_finish(tellenc_ctx* ctx)
+{
+    if (!ctx->feeding) {
+        tellenc_begin(ctx->ws);
+    }
+    ctx->feeding = false;
+    ctx->result = tellenc_finish(ctx->ws);
+    return ctx->result;
+}
+
+void tellenc_ctx_detect_batch(tellenc_ctx* ctx, const void* const* buffers,
+                              const size_t* lens, size_t count, int* results)
+{
+    const unsigned char* const* texts = (const unsigned char* const*)buffers;
+    ctx->feeding = false;
+#if TELLENC_HAS_THREADS
+    if (ctx->pool) {
+        ctx->pool->detect(texts, lens, count, results);
+    } else {
+        tellenc_detect_batch(ctx->ws, texts, lens, count, results);
+    }
+#else
+    tellenc_detect_batch(ctx->ws, texts, lens, count, results);
+#endif
+    ctx->result = count ? tellenc_encoding_t(results[count - 1])
+                        : TELLENC_UNKNOWN;
+}
+
+int tellenc_ctx_encoding(const tellenc_ctx* ctx)
+{
+    return ctx->result;
+}
+
+size_t tellenc_ctx_stat(const tellenc_ctx* ctx, int stat)
+{
+    const tellenc_workspace_t& ws = ctx->ws;
+    if (stat >= TELLENC_STAT_LINE_ENDING && stat <= TELLENC_STAT_DOS_EOF) {
+        return text_info_stat(tellenc_text_info(ws), stat);
+    }
+    switch (stat) {
+    case TELLENC_STAT_BYTES:
+        return count_stat(ws.pos);
+    case TELLENC_STAT_DBYTES:
+        return count_stat(ws.dbyte_cnt);
+    case TELLENC_STAT_DBYTES_HIHI:
+        return count_stat(ws.dbyte_hihi_cnt);
+    case TELLENC_STAT_DBYTES_UNIQUE:
+        return ws.dbyte_uniq_cnt;
+    case TELLENC_STAT_IS_BINARY:
+        return ws.is_binary;
+    case TELLENC_STAT_IS_VALID_UTF8:
+        return ws.is_valid_utf8;
+    case TELLENC_STAT_IS_VALID_LATIN1:
+        return ws.is_valid_latin1;
+    case TELLENC_STAT_UTF8_CHARS:
+        return count_stat(ws.utf8_char_cnt);
+    case TELLENC_STAT_UTF8_DOUBLE_CHARS:
+        return count_stat(ws.utf8_double_cnt);
+    case TELLENC_STAT_IS_DOUBLE_ENCODED:
+        return ctx->result == TELLENC_UTF_8 && tellenc_is_double_encoded(ws);
+    case TELLENC_STAT_UTF8_ERRORS:
+        return count_stat(ws.utf8_errors);
+    case TELLENC_STAT_UTF8_FIRST_ERROR:
+        return ws.utf8_errors ? count_stat(ws.utf8_error_offsets[0]) : 0;
+    default:
+        return 0;
+    }
+}
+
+double tellenc_ctx_confidence(const tellenc_ctx* ctx)
+{
+    return tellenc_confidence(ctx->ws);
+}
+
+int tellenc_ctx_language(const tellenc_ctx* ctx, double* confidence)
+{
+    return tellenc_language(ctx->ws, confidence);
+}
+
+const char* tellenc_language_name_of(int language)
+{
+    return tellenc_language_name(tellenc_language_t(language));
+}
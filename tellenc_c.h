@@ -0,0 +1,243 @@
+﻿// vim: expandtab shiftwidth=4 softtabstop=4 tabstop=4
+
+/*
+ * Copyright (C) 2006-2016 Wu Yongwei <wuyongwei@gmail.com>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must
+ *    not claim that you wrote the original software.  If you use this
+ *    software in a product, an acknowledgement in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must
+ *    not be misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source
+ *    distribution.
+ *
+ *
+ * The latest version of this software should be available at:
+ *      <URL:https://github.com/adah1972/tellenc>
+ *
+ */
+
+/**
+ * @file    tellenc_c.h
+ *
+ * Stable C interface of the tellenc library, for use from C and from
+ * other languages through their C foreign function interfaces.  Build
+ * tellenc_c.cpp as a shared library (libtellenc.so/tellenc.dll) with
+ * TELLENC_BUILD_DLL defined; define TELLENC_DLL when using the DLL on
+ * Windows.
+ *
+ * Encodings are identified by integers, which are the values of
+ * tellenc_encoding_t in tellenc.h and never change between versions.
+ * Functions are only added, never changed.
+ *
+ * @version 1.22, 2016/07/26
+ * @author  Wu Yongwei
+ */
+
+#ifndef TELLENC_C_H
+#define TELLENC_C_H
+
+#include <stddef.h>         // size_t
+
+#if defined(_WIN32)
+#if defined(TELLENC_BUILD_DLL)
+#define TELLENC_API __declspec(dllexport)
+#elif defined(TELLENC_DLL)
+#define TELLENC_API __declspec(dllimport)
+#else
+#define TELLENC_API
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 4
+#define TELLENC_API __attribute__((visibility("default")))
+#else
+#define TELLENC_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELLENC_ABI_VERSION 1
+
+/** Opaque detection context; one per thread. */
+typedef struct tellenc_ctx tellenc_ctx;
+
+/**
+ * Memory allocator for a context.  Detection itself never allocates:
+ * only creating a context and setting TELLENC_OPTION_THREADS do.
+ */
+typedef struct tellenc_allocator {
+    /** Returns \a size bytes aligned to \a align, or NULL. */
+    void* (*allocate)(void* user_data, size_t size, size_t align);
+    /** Frees memory from allocate; \a size is the size requested. */
+    void (*deallocate)(void* user_data, void* ptr, size_t size);
+    /** Passed to allocate and deallocate */
+    void* user_data;
+} tellenc_allocator;
+
+/** Options for tellenc_ctx_set_option. */
+enum {
+    TELLENC_OPTION_VERBOSE = 1,     /**< Print statistics to stdout */
+    TELLENC_OPTION_THREADS,         /**< Threads for batch detection */
+    TELLENC_OPTION_SNIFF_DECLARED,  /**< Trust a declared charset (0) */
+    TELLENC_OPTION_MAX_UTF8_ERRORS, /**< Invalid UTF-8 allowed, in ppm */
+    TELLENC_OPTION_DBYTE_SKETCH,    /**< Count double-bytes in 1.6 KB (0) */
+    TELLENC_OPTION_STOP_EARLY       /**< Stop at one candidate left (0) */
+};
+
+/** Statistics of the last detection, for tellenc_ctx_stat. */
+enum {
+    TELLENC_STAT_BYTES = 1,         /**< Bytes examined */
+    TELLENC_STAT_DBYTES,            /**< Double-bytes */
+    TELLENC_STAT_DBYTES_HIHI,       /**< Double-bytes of two high bytes */
+    TELLENC_STAT_DBYTES_UNIQUE,     /**< Distinct double-bytes */
+    TELLENC_STAT_IS_BINARY,         /**< 1 if non-text bytes appear */
+    TELLENC_STAT_IS_VALID_UTF8,     /**< 1 if valid as UTF-8 */
+    TELLENC_STAT_IS_VALID_LATIN1,   /**< 1 if no 0x80-0x9F bytes */
+    TELLENC_STAT_UTF8_CHARS,        /**< Non-ASCII UTF-8 characters */
+    TELLENC_STAT_UTF8_DOUBLE_CHARS, /**< Of them double-encoded */
+    TELLENC_STAT_IS_DOUBLE_ENCODED, /**< 1 if UTF-8 mostly double-encoded */
+    TELLENC_STAT_UTF8_ERRORS,       /**< Invalid UTF-8 sequences */
+    TELLENC_STAT_UTF8_FIRST_ERROR,  /**< Offset of the first one */
+    TELLENC_STAT_LINE_ENDING,       /**< 0-4: none, LF, CRLF, CR, mixed */
+    TELLENC_STAT_LF,                /**< LFs not after a CR */
+    TELLENC_STAT_CRLF,              /**< CR LF pairs */
+    TELLENC_STAT_CR,                /**< CRs not before an LF */
+    TELLENC_STAT_TABS,              /**< Tab characters */
+    TELLENC_STAT_TAB_INDENTED,      /**< Lines starting with a tab */
+    TELLENC_STAT_SPACE_INDENTED,    /**< Lines starting with a space */
+    TELLENC_STAT_HAS_BOM,           /**< 1 if the text starts with a BOM */
+    TELLENC_STAT_FINAL_NEWLINE,     /**< 1 if the last line is ended */
+    TELLENC_STAT_DOS_EOF            /**< 1 if it ends with a Ctrl-Z */
+};
+
+/** Returns TELLENC_ABI_VERSION of the library. */
+TELLENC_API int tellenc_abi_version(void);
+
+/** Returns the name of an encoding, like "utf-8"; "unknown" if invalid. */
+TELLENC_API const char* tellenc_encoding_name_of(int encoding);
+
+/**
+ * Returns the encoding of a name, an IANA name or an alias (ignoring
+ * case), or 0 (unknown).
+ */
+TELLENC_API int tellenc_encoding_id_of(const char* name);
+
+/** Returns the preferred MIME name of an encoding, or NULL if none. */
+TELLENC_API const char* tellenc_encoding_iana_name_of(int encoding);
+
+/** Returns the bytes per code unit of an encoding, or 0 if not text. */
+TELLENC_API int tellenc_encoding_byte_width_of(int encoding);
+
+/** Returns 1 if ASCII bytes mean ASCII characters in an encoding. */
+TELLENC_API int tellenc_encoding_is_ascii_compatible(int encoding);
+
+/** Creates a context; returns NULL when out of memory. */
+TELLENC_API tellenc_ctx* tellenc_ctx_create(void);
+
+/**
+ * Creates a context whose memory comes from \a allocator, which must
+ * stay valid until the context is destroyed; returns NULL when out of
+ * memory.
+ */
+TELLENC_API tellenc_ctx* tellenc_ctx_create_with_allocator(
+        const tellenc_allocator* allocator);
+
+/** Discards any incremental detection in progress; options are kept. */
+TELLENC_API void tellenc_ctx_reset(tellenc_ctx* ctx);
+
+/** Destroys a context; NULL is allowed. */
+TELLENC_API void tellenc_ctx_destroy(tellenc_ctx* ctx);
+
+/**
+ * Sets an option; returns 0 on success, or -1 if the option or value is
+ * not supported, or memory is insufficient.
+ */
+TELLENC_API int tellenc_ctx_set_option(tellenc_ctx* ctx, int option,
+                                       long value);
+
+/**
+ * Restricts the encodings that may be reported to \a count candidates,
+ * weighted by \a priors (all 1 if NULL) where the statistics only favour
+ * one encoding over another.  Detection skips the work for the other
+ * encodings, and with TELLENC_OPTION_STOP_EARLY, stops once one
+ * candidate is left that fits the text.  A \a count of 0 allows all the
+ * encodings again.  Returns 0 on success,
+ * or -1 if an encoding or a prior (which must be positive) is invalid.
+ */
+TELLENC_API int tellenc_ctx_set_candidates(tellenc_ctx* ctx,
+                                           const int* encodings,
+                                           const double* priors,
+                                           size_t count);
+
+/** Detects the encoding of a buffer at once. */
+TELLENC_API int tellenc_ctx_detect(tellenc_ctx* ctx, const void* buffer,
+                                   size_t len);
+
+/**
+ * Feeds the next chunk of an incremental detection, which starts after
+ * creation, reset or finish.  Returns 1 if the encoding is already
+ * decided (the rest need not be fed), or 0.
+ */
+TELLENC_API int tellenc_ctx_feed(tellenc_ctx* ctx, const void* buffer,
+                                 size_t len);
+
+/** Finishes an incremental detection, and returns the encoding. */
+TELLENC_API int tellenc_ctx_finish(tellenc_ctx* ctx);
+
+/**
+ * Detects the encodings of many buffers, with the number of threads set
+ * by TELLENC_OPTION_THREADS (1 by default).  It is much cheaper than
+ * detecting the buffers one by one.  The statistics afterwards are
+ * unspecified.
+ *
+ * @param buffers  array of count buffer pointers
+ * @param lens     array of count buffer lengths
+ * @param results  array of count encodings to fill
+ */
+TELLENC_API void tellenc_ctx_detect_batch(tellenc_ctx* ctx,
+                                          const void* const* buffers,
+                                          const size_t* lens, size_t count,
+                                          int* results);
+
+/** Returns the encoding found by the last detection. */
+TELLENC_API int tellenc_ctx_encoding(const tellenc_ctx* ctx);
+
+/**
+ * Returns a statistic of the last detection, or 0 if it is unknown.
+ * Counts are capped at SIZE_MAX.
+ */
+TELLENC_API size_t tellenc_ctx_stat(const tellenc_ctx* ctx, int stat);
+
+/**
+ * Returns how sure the last detection is, from 0 to 1: 1 when the
+ * structure of the text tells the encoding, less when it is guessed from
+ * statistics, and 0 when unknown.
+ */
+TELLENC_API double tellenc_ctx_confidence(const tellenc_ctx* ctx);
+
+/**
+ * Returns the likely language of the text of the last detection (a value
+ * of tellenc_language_t), or 0 if unknown, and stores its probability in
+ * \a confidence if not NULL.
+ */
+TELLENC_API int tellenc_ctx_language(const tellenc_ctx* ctx,
+                                     double* confidence);
+
+/** Returns the ISO 639-1 code of a language, like "fr"; "unknown" if 0. */
+TELLENC_API const char* tellenc_language_name_of(int language);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TELLENC_C_H */
@@ -0,0 +1,226 @@
+﻿// vim: expandtab shiftwidth=4 softtabstop=4 tabstop=4
+
+/*
+ * Copyright (C) 2006-2016 Wu Yongwei <wuyongwei@gmail.com>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must
+ *    not claim that you wrote the original software.  If you use this
+ *    software in a product, an acknowledgement in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must
+ *    not be misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source
+ *    distribution.
+ *
+ *
+ * The latest version of this software should be available at:
+ *      <URL:https://github.com/adah1972/tellenc>
+ *
+ */
+
+/**
+ * @file    tellenc_threads.h
+ *
+ * Batch detection in several threads for C++11.  A tellenc_batch_pool
+ * keeps its threads between batches, and hands the texts out in short
+ * runs, so that the threads stay busy however the sizes of the texts
+ * vary.  The core header tellenc.h does not depend on it.
+ *
+ * @version 1.22, 2016/07/26
+ * @author  Wu Yongwei
+ */
+
+#ifndef TELLENC_THREADS_H
+#define TELLENC_THREADS_H
+
+#include "tellenc.h"
+
+#if __cplusplus < 201103L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201103L)
+#error "tellenc_threads.h requires C++11"
+#endif
+
+#include <atomic>           // atomic
+#include <condition_variable>   // condition_variable
+#include <mutex>            // mutex/unique_lock
+#include <thread>           // thread
+
+#define TELLENC_HAS_THREADS 1
+
+namespace tellenc_detail {
+
+static const size_t MAX_BATCH_THREADS = 64;
+static const size_t BATCH_RUN_TEXTS = 16;   // taken by a thread at a time
+
+} // namespace tellenc_detail
+
+/**
+ * Threads that detect the encodings of batches of texts, one workspace
+ * each.  The thread calling detect works on the batch too, so a pool of
+ * \a ws_count workspaces starts \a ws_count - 1 threads.  Older GCC
+ * versions need the \c -pthread option.
+ */
+class tellenc_batch_pool {
+public:
+    /**
+     * Starts the threads.  If a thread cannot be started, the pool goes
+     * on with fewer.
+     *
+     * @param workspaces  array of \a ws_count workspaces, which must
+     *                    outlive the pool
+     * @param ws_count    number of workspaces, at most 64
+     */
+    tellenc_batch_pool(tellenc_workspace_t* const* workspaces,
+                       size_t ws_count)
+        : workspaces_(workspaces), thread_count_(0), batch_(nullptr),
+          generation_(0), busy_count_(0), stopping_(false), next_(0)
+    {
+        if (ws_count > tellenc_detail::MAX_BATCH_THREADS) {
+            ws_count = tellenc_detail::MAX_BATCH_THREADS;
+        }
+        for (size_t i = 1; i < ws_count; ++i) {
+            try {
+                threads_[thread_count_] =
+                    std::thread(&tellenc_batch_pool::work, this, i);
+            } catch (...) {
+                break;
+            }
+            ++thread_count_;
+        }
+    }
+
+    ~tellenc_batch_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (size_t i = 0; i < thread_count_; ++i) {
+            threads_[i].join();
+        }
+    }
+
+    /** Gets the number of workspaces in use, the calling thread's too. */
+    size_t size() const noexcept
+    {
+        return thread_count_ + 1;
+    }
+
+    /**
+     * Same as the single-workspace tellenc_detect_batch, but processed by
+     * all the threads of the pool.  Only one batch runs at a time.  The
+     * statistics in the workspaces are those of the last texts each
+     * thread processed.
+     */
+    template <typename OutputIt>
+    void detect(const unsigned char* const* buffers, const size_t* lens,
+                size_t count, OutputIt results)
+    {
+        if (thread_count_ == 0 || count <= tellenc_detail::BATCH_RUN_TEXTS) {
+            tellenc_detail::detect_batch(*workspaces_[0], buffers, lens,
+                                         count, results);
+            return;
+        }
+        std::lock_guard<std::mutex> batch_lock(batch_mutex_);
+        batch_t batch = { buffers, lens, count, &results, run<OutputIt> };
+        next_.store(0);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch_ = &batch;
+            busy_count_ = thread_count_;
+            ++generation_;
+        }
+        work_ready_.notify_all();
+        run_batch(batch, *workspaces_[0]);
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (busy_count_ != 0) {
+            work_done_.wait(lock);
+        }
+        batch_ = nullptr;
+    }
+
+private:
+    struct batch_t {
+        const unsigned char* const* buffers;
+        const size_t*   lens;
+        size_t          count;
+        void*           results;        ///< Pointer to an OutputIt
+        void (*run)(const batch_t& batch, tellenc_workspace_t& ws,
+                    size_t first, size_t count);
+    };
+
+    template <typename OutputIt>
+    static void run(const batch_t& batch, tellenc_workspace_t& ws,
+                    size_t first, size_t count)
+    {
+        OutputIt& results = *static_cast<OutputIt*>(batch.results);
+        tellenc_detail::detect_batch(ws, batch.buffers + first,
+                                     batch.lens + first, count,
+                                     results + first);
+    }
+
+    /** Takes runs of texts until none is left. */
+    void run_batch(const batch_t& batch, tellenc_workspace_t& ws)
+    {
+        for (;;) {
+            size_t first = next_.fetch_add(tellenc_detail::BATCH_RUN_TEXTS);
+            if (first >= batch.count) {
+                return;
+            }
+            batch.run(batch, ws, first,
+                      std::min(tellenc_detail::BATCH_RUN_TEXTS,
+                               batch.count - first));
+        }
+    }
+
+    void work(size_t index)
+    {
+        unsigned long generation = 0;
+        for (;;) {
+            const batch_t* batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (!stopping_ && generation_ == generation) {
+                    work_ready_.wait(lock);
+                }
+                if (stopping_) {
+                    return;
+                }
+                generation = generation_;
+                batch = batch_;
+            }
+            run_batch(*batch, *workspaces_[index]);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_count_ == 0) {
+                work_done_.notify_one();
+            }
+        }
+    }
+
+    tellenc_batch_pool(const tellenc_batch_pool&) = delete;
+    tellenc_batch_pool& operator=(const tellenc_batch_pool&) = delete;
+
+    tellenc_workspace_t* const* workspaces_;
+    std::thread         threads_[tellenc_detail::MAX_BATCH_THREADS];
+    size_t              thread_count_;
+
+    std::mutex          batch_mutex_;       ///< One batch at a time
+    std::mutex          mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    const batch_t*      batch_;
+    unsigned long       generation_;        ///< Batches started
+    size_t              busy_count_;        ///< Threads still on it
+    bool                stopping_;
+    std::atomic<size_t> next_;              ///< First text not taken
+};
+
+#endif // TELLENC_THREADS_H
@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# Regression tests of the files that the tellenc program writes and
+# reads: scan results and checkpoints, --merge, and the index.  Run it
+# from the top directory with the program to test:
+#
+#     tests/cli_test.sh ./tellenc
+#
+# It prints the failed checks, and exits with failure if there are any.
+
+tellenc=${1:-./tellenc}
+dir=$(dirname "$0")
+tmp=${TMPDIR:-/tmp}/tellenc_test.$$
+mkdir "$tmp" || exit 1
+trap 'rm -rf "$tmp"' 0
+failures=0
+
+fail()
+{
+    echo "check failed: $*"
+    failures=$((failures + 1))
+}
+
+# The results expected, as a scan writes them
+awk -v samples="$dir/samples" '{ printf "%s/%s\t%s\n", samples, $1, $2 }' \
+    "$dir/samples.txt" > "$tmp/expected"
+cut -f 1 "$tmp/expected" > "$tmp/paths"
+LC_ALL=C sort "$tmp/expected" > "$tmp/sorted"
+
+# A checkpoint holds the results, and nothing is scanned again
+"$tellenc" --checkpoint="$tmp/ck" --files-from="$tmp/paths" ||
+    fail "scan with a checkpoint"
+cmp -s "$tmp/ck" "$tmp/expected" || fail "checkpoint"
+"$tellenc" --checkpoint="$tmp/ck" --files-from="$tmp/paths" ||
+    fail "scan resumed"
+cmp -s "$tmp/ck" "$tmp/expected" || fail "checkpoint after a re-run"
+
+# A record cut short by a crash is dropped, and its file scanned again
+head -n 5 "$tmp/expected" > "$tmp/ck"
+sed -n 6p "$tmp/expected" | cut -c 1-10 | tr -d '\n' >> "$tmp/ck"
+"$tellenc" --checkpoint="$tmp/ck" --files-from="$tmp/paths" ||
+    fail "scan after a crash"
+cmp -s "$tmp/ck" "$tmp/expected" || fail "checkpoint after a crash"
+
+# The shards together are the whole, and merge sorted by path; the last
+# record of a path wins
+for i in 0 1 2; do
+    "$tellenc" --shard=$i/3 --files-from="$tmp/paths" > "$tmp/shard$i" ||
+        fail "shard $i"
+done
+"$tellenc" --merge "$tmp/shard0" "$tmp/shard1" "$tmp/shard2" \
+    > "$tmp/merged" || fail "merge"
+cmp -s "$tmp/merged" "$tmp/sorted" || fail "merged shards"
+head -n 1 "$tmp/sorted" | cut -f 1 | sed 's/$/	old/' > "$tmp/old"
+"$tellenc" --merge "$tmp/old" "$tmp/merged" > "$tmp/remerged" ||
+    fail "merge again"
+cmp -s "$tmp/remerged" "$tmp/sorted" || fail "last record wins"
+
+# The index lists the same results, and is only updated where needed
+"$tellenc" --index="$tmp/index" --files-from="$tmp/paths" ||
+    fail "index"
+"$tellenc" --query="$tmp/index" | cut -f 1,2 > "$tmp/queried" ||
+    fail "query"
+cmp -s "$tmp/queried" "$tmp/sorted" || fail "query of all"
+"$tellenc" --query="$tmp/index" --prefix="$dir/samples/ja." \
+    --encoding=sjis | cut -f 1,2 > "$tmp/queried"
+grep '/ja\.[^/]*	sjis$' "$tmp/sorted" | cmp -s - "$tmp/queried" ||
+    fail "query by prefix and encoding"
+files=$("$tellenc" --query="$tmp/index" --summary |
+        awk '{ files += $2 } END { print files }')
+[ "$files" = "$(wc -l < "$tmp/paths" | tr -d ' ')" ] ||
+    fail "query summary"
+"$tellenc" -v --index="$tmp/index" | grep -q ' 0 rechecked$' ||
+    fail "index refreshed without changes"
+echo "tellenc index" > "$tmp/bad"
+"$tellenc" --query="$tmp/bad" > /dev/null 2>&1 && fail "corrupt index"
+
+if [ $failures -ne 0 ]; then
+    echo "$failures checks failed"
+    exit 1
+fi
+echo "All CLI tests passed"
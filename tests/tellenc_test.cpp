@@ -0,0 +1,388 @@
+﻿// vim: expandtab shiftwidth=4 softtabstop=4 tabstop=4
+
+/*
+ * Copyright (C) 2006-2016 Wu Yongwei <wuyongwei@gmail.com>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty.  In no event will the authors be held liable for any
+ * damages arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute
+ * it freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must
+ *    not claim that you wrote the original software.  If you use this
+ *    software in a product, an acknowledgement in the product
+ *    documentation would be appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must
+ *    not be misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source
+ *    distribution.
+ *
+ *
+ * The latest version of this software should be available at:
+ *      <URL:https://github.com/adah1972/tellenc>
+ *
+ */
+
+/**
+ * @file    tellenc_test.cpp
+ *
+ * Regression tests of tellenc.  Build and run it from the top directory:
+ *
+ *      g++ -O2 tests/tellenc_test.cpp tellenc_c.cpp -o tellenc_test
+ *      ./tellenc_test tests
+ *
+ * The argument is the directory of samples.txt, which lists the sample
+ * files under samples/ with their encodings.  It prints the failed
+ * checks, and exits with failure if there are any.
+ *
+ * @version 1.22, 2016/07/26
+ * @author  Wu Yongwei
+ */
+
+#include <map>              // map
+#include <string>           // string
+#include <vector>           // vector
+#include <stdio.h>          // fopen/fclose/fread/fscanf/printf
+#include <stdlib.h>         // EXIT_FAILURE/EXIT_SUCCESS
+#include <string.h>         // strcmp
+#include "../tellenc.h"
+#include "../tellenc_c.h"
+
+using std::map;
+using std::string;
+using std::vector;
+
+typedef vector<unsigned char> buffer_t;
+
+struct sample_t {
+    string          name;
+    string          enc;
+    buffer_t        text;
+};
+
+static int failures = 0;
+
+#define CHECK(expr) check((expr), #expr, __FILE__, __LINE__)
+
+static void check(bool passed, const char* expr, const char* file,
+                  int line)
+{
+    if (!passed) {
+        printf("%s:%d: check failed: %s\n", file, line, expr);
+        ++failures;
+    }
+}
+
+// Deterministic pseudo-random numbers, the same on every platform
+static unsigned long rand_state = 1;
+
+static unsigned long next_rand()
+{
+    rand_state = (rand_state * 1103515245UL + 12345UL) & 0x7fffffffUL;
+    return rand_state >> 8;
+}
+
+typedef map<unsigned, tellenc_count_t> dbyte_counts_t;
+
+/**
+ * Checks the heap and hash chains of a sketch, and that each count is
+ * not below the real one and above it by at most the error.
+ */
+static void check_sketch(const tellenc_dbyte_sketch_t& sketch,
+                         dbyte_counts_t& real)
+{
+    using namespace tellenc_detail;
+    for (uint32_t pos = 1; pos < sketch.size; ++pos) {
+        CHECK(sketch.counts[sketch.heap[(pos - 1) / 2]] <=
+              sketch.counts[sketch.heap[pos]]);
+    }
+    for (uint32_t i = 0; i < sketch.size; ++i) {
+        CHECK(sketch.heap[sketch.heap_pos[i]] == i);
+        CHECK(find_in_sketch(sketch, sketch.dbytes[i]) == i + 1);
+        tellenc_count_t count = real[sketch.dbytes[i]];
+        CHECK(sketch.counts[i] >= count);
+        CHECK(sketch.counts[i] - sketch.errors[i] <= count);
+    }
+}
+
+/**
+ * Counts skewed random double-bytes in two sketches, each with many more
+ * double-bytes than it keeps, and checks them before and after merging.
+ */
+static void test_dbyte_sketch()
+{
+    static tellenc_workspace_t ws1;
+    static tellenc_workspace_t ws2;
+    for (int round = 0; round < 20; ++round) {
+        tellenc_begin(ws1);
+        tellenc_begin(ws2);
+        dbyte_counts_t real1;
+        dbyte_counts_t real2;
+        dbyte_counts_t real;
+        for (int i = 0; i < 20000; ++i) {
+            // Some double-bytes are frequent, and the rest are rare
+            unsigned dbyte = 0x8140 + (next_rand() % 3 != 0
+                                           ? next_rand() % 40
+                                           : next_rand() % 3000);
+            bool first_part = (i + round) % 3 != 0;
+            tellenc_detail::add_to_sketch(first_part ? ws1.dbyte_sketch
+                                                     : ws2.dbyte_sketch,
+                                          (unsigned short)dbyte, 1, 0);
+            ++(first_part ? real1 : real2)[dbyte];
+            ++real[dbyte];
+        }
+        CHECK(ws1.dbyte_sketch.size == tellenc_detail::DBYTE_SKETCH_SIZE);
+        CHECK(ws2.dbyte_sketch.size == tellenc_detail::DBYTE_SKETCH_SIZE);
+        check_sketch(ws1.dbyte_sketch, real1);
+        check_sketch(ws2.dbyte_sketch, real2);
+        tellenc_merge_dbyte_sketch(ws1.dbyte_sketch, ws2.dbyte_sketch);
+        check_sketch(ws1.dbyte_sketch, real);
+    }
+
+    // A double-byte that the second part dropped after 50 occurrences
+    // must keep them in the merged count
+    tellenc_begin(ws1);
+    tellenc_begin(ws2);
+    dbyte_counts_t real;
+    tellenc_detail::add_to_sketch(ws1.dbyte_sketch, 0x8140, 200, 0);
+    tellenc_detail::add_to_sketch(ws2.dbyte_sketch, 0x8140, 50, 0);
+    real[0x8140] = 250;
+    for (unsigned dbyte = 0x8141;
+            dbyte <= 0x8140 + tellenc_detail::DBYTE_SKETCH_SIZE; ++dbyte) {
+        tellenc_detail::add_to_sketch(ws2.dbyte_sketch,
+                                      (unsigned short)dbyte, 100, 0);
+        real[dbyte] = 100;
+    }
+    CHECK(tellenc_detail::find_in_sketch(ws2.dbyte_sketch, 0x8140) == 0);
+    tellenc_merge_dbyte_sketch(ws1.dbyte_sketch, ws2.dbyte_sketch);
+    CHECK(tellenc_detail::find_in_sketch(ws1.dbyte_sketch, 0x8140) != 0);
+    check_sketch(ws1.dbyte_sketch, real);
+}
+
+static bool read_file(const string& filename, buffer_t& buffer)
+{
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    unsigned char chunk[4096];
+    size_t len;
+    while ((len = fread(chunk, 1, sizeof chunk, fp)) != 0) {
+        buffer.insert(buffer.end(), chunk, chunk + len);
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool read_samples(const string& dir, vector<sample_t>& samples)
+{
+    string list = dir + "/samples.txt";
+    FILE* fp = fopen(list.c_str(), "r");
+    if (fp == NULL) {
+        printf("Cannot open `%s'\n", list.c_str());
+        return false;
+    }
+    char name[256];
+    char enc[256];
+    while (fscanf(fp, "%255s %255s", name, enc) == 2) {
+        sample_t sample;
+        sample.name = name;
+        sample.enc = enc;
+        if (!read_file(dir + "/samples/" + name, sample.text)) {
+            printf("Cannot read sample `%s'\n", name);
+            fclose(fp);
+            return false;
+        }
+        samples.push_back(sample);
+    }
+    fclose(fp);
+    return !samples.empty();
+}
+
+static tellenc_encoding_t feed_in_chunks(tellenc_workspace_t& ws,
+                                         const buffer_t& text,
+                                         size_t chunk_size)
+{
+    tellenc_begin(ws);
+    for (size_t pos = 0; pos < text.size(); pos += chunk_size) {
+        size_t len = std::min(chunk_size, text.size() - pos);
+        if (tellenc_feed(ws, &text[pos], len)) {
+            break;
+        }
+    }
+    return tellenc_finish(ws);
+}
+
+/**
+ * Detects each sample whole and in chunks of a few sizes, which checks
+ * that the state machines of the escapes, UTF-16 and GB18030 carry over
+ * chunks.  The double-byte sketch must give the same result on them.
+ */
+static void test_samples(const vector<sample_t>& samples)
+{
+    static tellenc_workspace_t ws;
+    static const size_t chunk_sizes[] = { 1, 2, 3, 7, 4096 };
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const sample_t& sample = samples[i];
+        const buffer_t& text = sample.text;
+        ws.use_dbyte_sketch = false;
+        tellenc_encoding_t enc = tellenc_detect(ws, &text[0], text.size());
+        if (sample.enc != tellenc_encoding_name(enc)) {
+            printf("%s: %s, not %s\n", sample.name.c_str(),
+                   tellenc_encoding_name(enc), sample.enc.c_str());
+            ++failures;
+        }
+        for (size_t j = 0; j < sizeof chunk_sizes / sizeof chunk_sizes[0];
+                ++j) {
+            CHECK(feed_in_chunks(ws, text, chunk_sizes[j]) == enc);
+        }
+        ws.use_dbyte_sketch = true;
+        CHECK(tellenc_detect(ws, &text[0], text.size()) == enc);
+    }
+    ws.use_dbyte_sketch = false;
+}
+
+/** Checks the C interface against the C++ one. */
+static void test_c_interface(const vector<sample_t>& samples)
+{
+    static tellenc_workspace_t ws;
+    CHECK(tellenc_abi_version() == TELLENC_ABI_VERSION);
+    for (int i = 0; i < TELLENC_ENCODING_COUNT; ++i) {
+        CHECK(tellenc_encoding_id_of(tellenc_encoding_name_of(i)) == i);
+    }
+    CHECK(strcmp(tellenc_encoding_name_of(-1), "unknown") == 0);
+
+    tellenc_ctx* ctx = tellenc_ctx_create();
+    CHECK(ctx != NULL);
+    if (ctx == NULL) {
+        return;
+    }
+    CHECK(tellenc_ctx_set_option(ctx, -1, 0) == -1);
+    vector<const void*> buffers;
+    vector<size_t> lens;
+    vector<int> expected;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const buffer_t& text = samples[i].text;
+        int enc = tellenc_detect(ws, &text[0], text.size());
+        CHECK(tellenc_ctx_detect(ctx, &text[0], text.size()) == enc);
+        CHECK(tellenc_ctx_encoding(ctx) == enc);
+        CHECK(tellenc_ctx_stat(ctx, TELLENC_STAT_BYTES) == text.size());
+        CHECK(tellenc_ctx_feed(ctx, &text[0], 1) == 0);
+        tellenc_ctx_feed(ctx, &text[1], text.size() - 1);
+        CHECK(tellenc_ctx_finish(ctx) == enc);
+        buffers.push_back(&text[0]);
+        lens.push_back(text.size());
+        expected.push_back(enc);
+    }
+    vector<int> results(samples.size());
+    tellenc_ctx_set_option(ctx, TELLENC_OPTION_THREADS, 2);
+    tellenc_ctx_detect_batch(ctx, &buffers[0], &lens[0], buffers.size(),
+                             &results[0]);
+    CHECK(results == expected);
+    tellenc_ctx_destroy(ctx);
+}
+
+static const sample_t* find_sample(const vector<sample_t>& samples,
+                                   const char* name)
+{
+    for (size_t i = 0; i < samples.size(); ++i) {
+        if (samples[i].name == name) {
+            return &samples[i];
+        }
+    }
+    printf("Sample `%s' not found\n", name);
+    ++failures;
+    return NULL;
+}
+
+/**
+ * Checks that the scan stops at one candidate left only when asked to,
+ * and that a text read only in part is not reported as certain.
+ */
+static void test_candidates(const vector<sample_t>& samples)
+{
+    static tellenc_workspace_t ws;
+    const sample_t* sjis = find_sample(samples, "ja.shift_jis");
+    const sample_t* ascii = find_sample(samples, "en.ascii");
+    if (sjis == NULL || ascii == NULL) {
+        return;
+    }
+    buffer_t text;
+    while (text.size() < 16000) {
+        text.insert(text.end(), sjis->text.begin(), sjis->text.end());
+    }
+    text.resize(16000);
+    const tellenc_encoding_t japanese[] = {
+        TELLENC_SJIS, TELLENC_EUC_JP, TELLENC_UTF_8
+    };
+    CHECK(tellenc_set_candidates(ws, japanese, NULL, 3));
+    CHECK(tellenc_detect(ws, &text[0], text.size()) == TELLENC_SJIS);
+    CHECK(ws.pos == text.size());
+    CHECK(tellenc_confidence(ws) == 1);
+    ws.stop_early = true;
+    CHECK(tellenc_detect(ws, &text[0], text.size()) == TELLENC_SJIS);
+    CHECK(ws.pos == tellenc_detail::CANDIDATE_CHECK_BYTES);
+    CHECK(tellenc_confidence(ws) <= 0.5);
+
+    // Binary bytes after the first check are still seen by default
+    text.clear();
+    while (text.size() < 6600) {
+        text.insert(text.end(), ascii->text.begin(), ascii->text.end());
+    }
+    text.resize(6600);
+    text.insert(text.end(), 200, 0);
+    text.insert(text.end(), 200, 0xff);
+    const tellenc_encoding_t utf8[] = { TELLENC_UTF_8 };
+    CHECK(tellenc_set_candidates(ws, utf8, NULL, 1));
+    ws.stop_early = false;
+    CHECK(tellenc_detect(ws, &text[0], text.size()) == TELLENC_BINARY);
+    CHECK(tellenc_set_candidates(ws, NULL, NULL, 0));
+    CHECK(tellenc_detect(ws, &text[0], text.size()) == TELLENC_BINARY);
+}
+
+/**
+ * Checks that the dense double-byte counts are halved, keeping their
+ * ranking, before they can overflow.
+ */
+static void test_dbyte_halving()
+{
+    static tellenc_workspace_t ws;
+    tellenc_begin(ws);
+    for (int i = 0; i < 1000; ++i) {
+        tellenc_detail::count_dbyte(ws, 0xb0, 0xa1, true);
+    }
+    for (int i = 0; i < 600; ++i) {
+        tellenc_detail::count_dbyte(ws, 0xb0, 0xa2, true);
+    }
+    tellenc_detail::count_dbyte(ws, 0xb0, 0xa3, true);
+    ws.dbyte_count_bound = tellenc_detail::MAX_DBYTE_COUNT - 10;
+    tellenc_detail::reserve_dbyte_counts(ws, 100);
+    CHECK(ws.dbyte_scale == 1);
+    CHECK(ws.dbyte_uniq_cnt == 2);
+    CHECK(ws.dbyte_char_cnt[0xb0a1 - tellenc_detail::MAX_DBYTE] == 500);
+    CHECK(ws.dbyte_char_cnt[0xb0a2 - tellenc_detail::MAX_DBYTE] == 300);
+    CHECK(ws.dbyte_char_cnt[0xb0a3 - tellenc_detail::MAX_DBYTE] == 0);
+    CHECK(ws.dbyte_count_bound <= tellenc_detail::MAX_DBYTE_COUNT - 100);
+}
+
+int main(int argc, char* argv[])
+{
+    vector<sample_t> samples;
+    if (!read_samples(argc > 1 ? argv[1] : "tests", samples)) {
+        return EXIT_FAILURE;
+    }
+    test_samples(samples);
+    test_c_interface(samples);
+    test_candidates(samples);
+    test_dbyte_halving();
+    test_dbyte_sketch();
+    if (failures != 0) {
+        printf("%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All tests passed\n");
+    return EXIT_SUCCESS;
+}